@@ -1,9 +1,9 @@
 /* DMA Routines using the universe driver */
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <errno.h>
 
-#include <epicsMutex.h>
 #include <epicsInterrupt.h>
 #include <errlog.h>
 #include <devLib.h>
@@ -69,14 +69,34 @@ unsigned ams[]={
 
 #undef DEBUG
 
-static epicsMutexId lock=0;
+/* Requests are queued and the ISR starts the next one as soon as the
+ * previous one has ended, so the bridge works back to back for all cards.
+ * The queue is protected by epicsInterruptLock.
+ */
+static int    inited=0;
 static DMA_ID inProgress=0;
+static DMA_ID queueHead=0;
+static DMA_ID queueTail=0;
+static int    queueDepth=0;
+static int    maxQueueDepth=0;
+static unsigned long nRequests=0;
+static unsigned long nQueued=0;
 
 typedef struct dmaRequest {
 		VOIDFUNCPTR				callback;
 		void					*closure;
 		STATUS					status;
 		unsigned long			dgcs;
+		struct dmaRequest		*next;		/* in the queue */
+		int						busy;		/* queued or in progress */
+		/* what to start; the PCI address is worked out by the submitter,
+		 * since the ISR starts queued requests */
+		unsigned long			pciAddr;
+		UINT32					vmeAddr;
+		int						length;
+		unsigned long			dctl;
+		UniverseDmaList			list;		/* 0 unless list-DMA */
+		UniverseDmaList			ownList;	/* of universeDmaListStartV */
 } DmaRequest;
 
 #define ERR_STAT_MASK (UNIV_DGCS_STATUS_CLEAR & ~UNIV_DGCS_DONE)
@@ -85,33 +105,153 @@ typedef struct dmaRequest {
 unsigned long universeDmaLastDGCS=0;
 #endif
 
+/* universe DMA packets need 32byte alignment */
+#define PACK_ALIGNMENT	32
+#define PACK_ALIGN(num)							\
+	( (VmeUniverseDMAPacket)					\
+	  ( (((UINT32)(num)) + (PACK_ALIGNMENT-1))	\
+	   & ~(PACK_ALIGNMENT-1)))
+
+/* Program the bridge for dmaId. Called with interrupts locked.
+ * RETURNS: 0 if the transfer was started
+ */
+static STATUS
+startRequest(DMA_ID dmaId)
+{
+unsigned long dgcs;
+
+	inProgress = dmaId;
+
+	if (dmaId->list) {
+		dgcs = vmeUniverseReadReg(UNIV_REGOFF_DGCS);
+
+	    /* clear global status register; set CHAIN flag */
+		dgcs |= UNIV_DGCS_CHAIN;
+		vmeUniverseWriteReg(dgcs, UNIV_REGOFF_DGCS);
+
+	    /* make sure count is 0 for linked list DMA */
+	    vmeUniverseWriteReg( 0x0, UNIV_REGOFF_DTBC);
+
+	    /* set the address of the descriptor chain */
+	    vmeUniverseWriteReg( LOCAL2PCI(PACK_ALIGN(dmaId->list)), UNIV_REGOFF_DCPP);
+
+		/* and GO */
+		dgcs |= UNIV_DGCS_GO;
+		vmeUniverseWriteReg(dgcs, UNIV_REGOFF_DGCS);
+		return 0;
+	}
+
+	vmeUniverseWriteReg(dmaId->dctl, UNIV_REGOFF_DCTL);
+
+#ifdef DEBUG
+	errlogPrintf("starting DMA from 0x%08x(VME) to 0x%08x (PCI); %i bytes\n",
+					dmaId->vmeAddr, dmaId->pciAddr, dmaId->length);
+#endif
+	return vmeUniverseStartDMA(dmaId->pciAddr,dmaId->vmeAddr,dmaId->length);
+}
+
+/* Start queued requests until one runs. Those the bridge refuses are
+ * put on *pfailed. Called with interrupts locked.
+ */
+static void
+startQueued(DMA_ID *pfailed)
+{
+DMA_ID dmaId;
+
+	while ( !inProgress && (dmaId = queueHead) ) {
+		queueHead = dmaId->next;
+		if ( !queueHead )
+			queueTail = 0;
+		queueDepth--;
+		if ( startRequest(dmaId) ) {
+			inProgress    = 0;
+			dmaId->status = EIO;
+			dmaId->next   = *pfailed;
+			*pfailed      = dmaId;
+		}
+	}
+}
+
+static void
+requestDone(DMA_ID dmaId)
+{
+	dmaId->busy = 0;
+	if (dmaId->callback)
+		dmaId->callback(dmaId->closure);
+}
+
 static void
 universeDMAisr(void *p)
 {
 unsigned long s=vmeUniverseReadReg(UNIV_REGOFF_DGCS);
+DMA_ID        done;
+DMA_ID        failed=0;
+int           key;
 
 #ifdef DEBUG
 	universeDmaLastDGCS=s;
 #endif
 
-	if (inProgress) {
-		inProgress->dgcs   = s;
-		inProgress->status = s & ERR_STAT_MASK ? EIO : 0;
-		if (inProgress->callback)
-				inProgress->callback(inProgress->closure);
-		inProgress = 0;
-	}
 	/* clear status by writing actual settings back */
 	vmeUniverseWriteReg(s,  UNIV_REGOFF_DGCS);
 	iobarrier_w();
-	/* yield the driver */
-	epicsMutexUnlock(lock);
+
+	/* start the next request before anybody is told */
+	key = epicsInterruptLock();
+	done = inProgress;
+	inProgress = 0;
+	startQueued(&failed);
+	epicsInterruptUnlock(key);
+
+	if (done) {
+		done->dgcs   = s;
+		done->status = s & ERR_STAT_MASK ? EIO : 0;
+		requestDone(done);
+	}
+	while (failed) {
+		done   = failed;
+		failed = done->next;
+		requestDone(done);
+	}
+}
+
+/* Start dmaId or queue it behind the one in progress.
+ * May be called from a completion callback.
+ */
+static STATUS
+submit(DMA_ID dmaId)
+{
+STATUS status;
+int    key;
+
+	key = epicsInterruptLock();
+	dmaId->busy = 1;
+	dmaId->next = 0;
+	nRequests++;
+	if (inProgress) {
+		if (queueTail)
+			queueTail->next = dmaId;
+		else
+			queueHead = dmaId;
+		queueTail = dmaId;
+		if (++queueDepth > maxQueueDepth)
+			maxQueueDepth = queueDepth;
+		nQueued++;
+		epicsInterruptUnlock(key);
+		return 0;
+	}
+	if ((status = startRequest(dmaId))) {
+		inProgress  = 0;
+		dmaId->busy = 0;
+	}
+	epicsInterruptUnlock(key);
+	return status;
 }
 
 static void
 universeDmaInit(void)
 {
-	lock=epicsMutexCreate();
+	inited=1;
 	/* clear possible pending IRQ */
 	vmeUniverseWriteReg(
 		UNIV_LINT_STAT_DMA,
@@ -137,11 +277,13 @@ universeDmaCreate(VOIDFUNCPTR callback, void *context)
 {
 DMA_ID	rval;
 	/* lazy init */
-	if (!lock) {
+	if (!inited) {
 		universeDmaInit();
 	}
 
-	rval = malloc(sizeof(*rval));
+	rval = calloc(1, sizeof(*rval));
+	if (!rval)
+		return 0;
 	rval->callback = callback;
 	rval->closure = context;
 
@@ -213,13 +355,6 @@ unsigned long dctl = 0;
 	return dctl;
 }
 
-/* universe DMA packets need 32byte alignment */
-#define PACK_ALIGNMENT	32
-#define PACK_ALIGN(num)							\
-	( (VmeUniverseDMAPacket)					\
-	  ( (((UINT32)(num)) + (PACK_ALIGNMENT-1))	\
-	   & ~(PACK_ALIGNMENT-1)))
-
 UniverseDmaList *
 universeDmaListSetup(
 	UniverseDmaBlock blk,		/* block list to scatter/gather */
@@ -299,62 +434,146 @@ void					*rval;
 	return rval;
 }
 
-STATUS
-universeDmaListStart(DMA_ID dmaId, UniverseDmaList l)
+UniverseDmaList *
+universeDmaListSetupV(
+	UniverseDmaSeg	seg,		/* transfers to chain */
+	int				nSegs,
+	int				flags
+	)
 {
-unsigned long dgcs;
+VmeUniverseDMAPacket	b,p,n;
+unsigned long			dctl;
+void					*rval;
+int						i;
 
-	dmaId->status = EINVAL;
-	dmaId->dgcs   = 0;
+	if ( nSegs <= 0 )
+		return 0;
+	/* check the parameters before anything is allocated */
+	for ( i=0; i<nSegs; i++ ) {
+		if ( ((unsigned long)seg[i].pLocal ^ seg[i].vmeAddr) & 7 )
+			return 0;
+		if ( (unsigned long)-1 == dctlSetup(seg[i].adrsSpace, seg[i].dataWidth) )
+			return 0;
+	}
+
+	/* alloc DMA packets */
+	rval = malloc(sizeof(*b) * nSegs + PACK_ALIGNMENT - 1);
 
-	epicsMutexLock(lock);
+	if ( !rval )
+		return 0;
 
-	inProgress = dmaId;
+	/* beginning of packet area */
+	b = PACK_ALIGN(rval);
+
+	for (n=b, i=0; i<nSegs; i++) {
+
+		p = n;
+
+		/* each packet has its own address space and width */
+		dctl = dctlSetup(seg[i].adrsSpace, seg[i].dataWidth);
+		dctl |= UNIV_DCTL_VCT | UNIV_DCTL_LD64EN;
+		if (flags & UNIVERSE_DMA_FLG_TO_VME)
+			dctl |= UNIV_DCTL_L2V;
 
-	dgcs = vmeUniverseReadReg(UNIV_REGOFF_DGCS);
+		p->dva  = (LERegister)seg[i].vmeAddr;
+		p->dla  = LOCAL2PCI(seg[i].pLocal);
+		p->dtbc = seg[i].len;
+		p->dctl = dctl;
 
-    /* clear global status register; set CHAIN flag */
-	dgcs |= UNIV_DGCS_CHAIN;
-	vmeUniverseWriteReg(dgcs, UNIV_REGOFF_DGCS);
+		/* next packet address */
+		n++;
+		p->dcpp = LOCAL2PCI(n);
+	}
+	/* close ring and mark end */
+	p->dcpp = LOCAL2PCI( (UINT32)b | UNIV_DCPP_IMG_NULL ); 
 
-    /* make sure count is 0 for linked list DMA */
-    vmeUniverseWriteReg( 0x0, UNIV_REGOFF_DTBC);
+	vmeUniverseCvtToLE((UINT32*)b, (UINT32*)n - (UINT32*)b);
 
-    /* set the address of the descriptor chain */
-    vmeUniverseWriteReg( LOCAL2PCI(PACK_ALIGN(l)), UNIV_REGOFF_DCPP);
+	return rval;
+}
 
-	/* and GO */
-	dgcs |= UNIV_DGCS_GO;
-	vmeUniverseWriteReg(dgcs, UNIV_REGOFF_DGCS);
+STATUS
+universeDmaListStart(DMA_ID dmaId, UniverseDmaList l)
+{
+	if (dmaId->busy) {
+		errno = EBUSY;
+		return -1;
+	}
+	dmaId->status = EINVAL;
+	dmaId->dgcs   = 0;
+	dmaId->list   = l;
 
-	return 0;
+	return submit(dmaId);
 }
 
+STATUS
+universeDmaListStartV(DMA_ID dmaId, UniverseDmaSeg seg, int nSegs, int flags)
+{
+	if (dmaId->busy) {
+		errno = EBUSY;
+		return -1;
+	}
+	/* the previous list has ended, since dmaId is not busy */
+	free(dmaId->ownList);
+	dmaId->ownList = universeDmaListSetupV(seg, nSegs, flags);
+	if (!dmaId->ownList) {
+		errno = EINVAL;
+		return -1;
+	}
+	return universeDmaListStart(dmaId, (UniverseDmaList)dmaId->ownList);
+}
 
 STATUS
 universeDmaStart(DMA_ID dmaId, void *pLocal, UINT32 vmeAddr,
 	int adrsSpace, int length, int dataWidth, unsigned long dctl)
 {
-STATUS status;
-
+	if (dmaId->busy) {
+		errno = EBUSY;
+		return -1;
+	}
 	dmaId->status = EINVAL;
 	dmaId->dgcs   = 0;
 
 	if ( (unsigned long)-1 == (dctl |= dctlSetup(adrsSpace, dataWidth)) )
 		return -1;
 
-	epicsMutexLock(lock);
-
-	inProgress = dmaId;
+	dmaId->list    = 0;
+	dmaId->dctl    = dctl;
+	dmaId->pciAddr = LOCAL2PCI(pLocal);
+	dmaId->vmeAddr = vmeAddr;
+	dmaId->length  = length;
 
-	vmeUniverseWriteReg(dctl, UNIV_REGOFF_DCTL);
+	return submit(dmaId);
+}
 
-#ifdef DEBUG
-	errlogPrintf("starting DMA from 0x%08x(VME) to 0x%08x (PCI); %i bytes\n",
-					vmeAddr, pLocal, length);
-#endif
-	if ((status=vmeUniverseStartDMA(LOCAL2PCI(pLocal),vmeAddr,length)))
-		epicsMutexUnlock(lock);
+STATUS
+universeDmaCancel(DMA_ID dmaId)
+{
+DMA_ID *pprev;
+DMA_ID last=0;
+int    key;
+
+	key = epicsInterruptLock();
+	for (pprev=&queueHead; *pprev; pprev=&(*pprev)->next) {
+		if (*pprev == dmaId) {
+			*pprev = dmaId->next;
+			if (queueTail == dmaId)
+				queueTail = last;
+			queueDepth--;
+			dmaId->busy = 0;
+			epicsInterruptUnlock(key);
+			return 0;
+		}
+		last = *pprev;
+	}
+	epicsInterruptUnlock(key);
+	return -1;
+}
 
-	return status;
+void
+universeDmaReport(int level)
+{
+	printf("universe DMA: requests %lu queued %lu depth %d max %d%s\n",
+		nRequests, nQueued, queueDepth, maxQueueDepth,
+		inProgress ? ", one in progress" : "");
 }
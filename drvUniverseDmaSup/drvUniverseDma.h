@@ -51,10 +51,28 @@ STATUS
 universeDmaToVme(DMA_ID dmaId, UINT32 vmeAddr, int adrsSpace,
     void *pLocal, int length, int dataWidth);
 
+/* The start routines queue the request while another one is in
+ * progress; the DMA ISR starts it when that one has ended and then calls
+ * the callback of the finished one. They may be called from a callback.
+ * Each DMA_ID holds one request at a time; while it is queued or in
+ * progress the start routines fail with errno EBUSY.
+ */
 STATUS
 universeDmaStart(DMA_ID dmaId, void *pLocal, UINT32 vmeAddr,
 	int adrsSpace, int length, int dataWidth, unsigned long dctl);
 
+/* take a request that has not started yet out of the queue; its
+ * callback is not called
+ *
+ * RETURNS: 0, or -1 if it is not queued
+ */
+STATUS
+universeDmaCancel(DMA_ID dmaId);
+
+/* print the number of requests and the queue depth */
+void
+universeDmaReport(int level);
+
 
 /* scatter/gather DMA
  *
@@ -114,11 +132,43 @@ universeDmaListSetup(
 	int				 flags
 	);
 
-/* start transferring a list-DMA
+/* A transfer of a list where both sides are scattered.
+ * Each transfer has its own address space and width.
+ */
+typedef struct UniverseDmaSegRec_ {
+	char	*pLocal;
+	UINT32	vmeAddr;
+	int		adrsSpace;
+	int		dataWidth;
+	long	len;
+} UniverseDmaSegRec, *UniverseDmaSeg;
+
+/* Like universeDmaListSetup but for nSegs transfers, each between
+ * its own local and VME address.
+ *  - UNIVERSE_DMA_FLG_CONTIG_VME is ignored
+ *  - every pLocal must be 8-byte aligned with its vmeAddr
  *
- * RETURNS: 0
+ * RETURNS: opaque handle to the initialized descriptor list, to be
+ *          released with 'free()', or NULL in case of invalid parameters
+ */
+UniverseDmaList *
+universeDmaListSetupV(
+	UniverseDmaSeg	seg,		/* transfers to chain */
+	int				nSegs,
+	int				flags
+	);
+
+/* start transferring a list-DMA, or queue it
+ *
+ * RETURNS: 0 if started or queued
  */
 STATUS
 universeDmaListStart(DMA_ID dmaId, UniverseDmaList l);
 
+/* universeDmaListSetupV and universeDmaListStart in one. The list
+ * belongs to dmaId, which frees it when it starts its next list.
+ */
+STATUS
+universeDmaListStartV(DMA_ID dmaId, UniverseDmaSeg seg, int nSegs, int flags);
+
 #endif
@@ -11,11 +11,27 @@
 * in file LICENSE that is included with this distribution.
 *************************************************************************/
 
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <pthread.h>
+#include <sched.h>
+#endif
+#if defined(vxWorks) && defined(_WRS_CONFIG_SMP)
+#include <vxWorks.h>
+#include <taskLib.h>
+#include <cpuset.h>
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <limits.h>
 
+#include <ellLib.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
 #include <epicsExport.h>
 #include <errlog.h>
 #include <dbStaticLib.h>
@@ -36,12 +52,48 @@
 #include <devLib.h>
 
 #include "drvGtr.h"
+#include "gtrUnpack.h"
 
+/* Buffer sets per card, taken when the first record of the card is
+ * initialized. With more than one set the driver reads into a set that no
+ * record shows while the records show the last complete one.
+ */
+#define MAXSETS 3
+int devGtrBufferSets = 1;
+epicsExportAddress(int,devGtrBufferSets);
+
+/* If non zero only signals with a monitored waveform record are read */
+int devGtrMonitoredOnly = 0;
+epicsExportAddress(int,devGtrMonitoredOnly);
+
+/* If non zero, taken when the first record of a card is initialized, an
+ * interrupt only counts the event. The card is read when a waveform
+ * record is processed after a new event, and all its waveform records
+ * are then processed with the data of that read.
+ */
+int devGtrLazyRead = 0;
+epicsExportAddress(int,devGtrLazyRead);
+
 typedef struct devGtrChannels {
     int nchannels;
-    gtrchannel *pachannel;
-    gtrchannel **papgtrchannel;
+    int nsets;
+    gtrchannel *pachannel[MAXSETS];
+    gtrchannel **papgtrchannel[MAXSETS];
+    int fill;               /* set being read into */
+    int ready;              /* set with the newest data */
+    int nuse[MAXSETS];      /* records whose bptr is, or that copy from, the set */
+    int waiting;            /* a read waits for a set to be free */
     int hasWaveforms;
+    ELLLIST waveforms;      /* dpvt of the waveform records */
+    int *nelm;              /* len of each channel when it is read */
+    /* FLOAT and DOUBLE values are gain*(raw-low)/(high-low) + calOffset,
+     * i.e. raw*scale + offset. scale and offset are computed when the
+     * calibration changes, not on every read.
+     */
+    double *gain;
+    double *calOffset;
+    double *scale;
+    double *offset;
 } devGtrChannels;
 
 typedef struct devGtr {
@@ -51,14 +103,58 @@ typedef struct devGtr {
     IOSCANPVT   ioscanpvt;
     int arm;
     devGtrChannels channels;
+    int reading;  /* startReadMemory has not called readDone yet */
+    int pending;  /* a trigger came while reading */
+    /* Only for cards given to devGtrReadThreadConfig */
+    epicsEventId readEvent;
+    epicsThreadId readThread;
+    int cpu;
+    /* Only for lazy read */
+    int lazy;
+    epicsUInt32 eventSeq;   /* counted by the interrupt handler */
+    epicsUInt32 readSeq;    /* eventSeq when the read started */
+    epicsUInt32 doneSeq;    /* eventSeq of the newest data */
+    int requested;          /* a record asked for a read */
+    IOSCANPVT waveformscanpvt; /* never requested, the reads process them */
 } devGtr;
 
+/* Readout threads asked for by devGtrReadThreadConfig */
+typedef struct readThreadConfig {
+    ELLNODE node;
+    int card;
+    int priority;
+    int stackSize;
+    int cpu;
+} readThreadConfig;
+static ELLLIST readThreadList;
+
+/* Calibrations loaded by devGtrCalibration */
+typedef struct calibrationEntry {
+    int signal;
+    double gain;
+    double offset;
+} calibrationEntry;
+typedef struct calibrationConfig {
+    ELLNODE node;
+    int card;
+    int nentries;
+    calibrationEntry *pentry;
+} calibrationConfig;
+static ELLLIST calibrationList;
+
 typedef struct dpvt{
+    ELLNODE  node;   /* waveforms of the card */
+    dbCommon *precord;
     int      parm;
     devGtr *pdevGtr;
     /* The following are only used by waveform record */
     int      signal; /*only used by waveform*/
     int      isPdataBptr;
+    int      set;    /* the set bptr is in if isPdataBptr */
+    /* Only for lazy read */
+    CALLBACK processCallback;
+    int      waitRead; /* pact is set until the read is done */
+    int      update;   /* show the newest data without a read */
 }dpvt;
 
 #define NBOPARM 2
@@ -107,6 +203,7 @@ static char *waveformParmString[NWFPARM] =
 };
 
 static long get_ioint_info(int cmd, dbCommon *precord, IOSCANPVT *pvt);
+static long waveform_get_ioint_info(int cmd,dbCommon *precord,IOSCANPVT *pvt);
 typedef struct bodset {
     long      number;
     DEVSUPFUN report;
@@ -171,30 +268,257 @@ typedef struct waveformdset {
 static long waveform_init_record(dbCommon *precord);
 static long waveform_read(dbCommon *precord);
 waveformdset devGtrWF =
-    {5,0,0,waveform_init_record,get_ioint_info,waveform_read};
+    {5,0,0,waveform_init_record,waveform_get_ioint_info,waveform_read};
 epicsExportAddress(dset,devGtrWF);
 
+/* Wake the readout thread of the card, or the callback thread.
+ * Called from interrupt level.
+ */
+static void requestRead(devGtr *pdevGtr)
+{
+    if(pdevGtr->readEvent) {
+        epicsEventSignal(pdevGtr->readEvent);
+    } else {
+        callbackRequest(&pdevGtr->callback);
+    }
+}
+
+/* Lazy read: process every waveform record of the card, completing those
+ * that wait for the read. Called with the card locked.
+ */
+static void processWaveforms(devGtr *pdevGtr)
+{
+    dpvt *pdpvt;
+
+    pdpvt = (dpvt *)ellFirst(&pdevGtr->channels.waveforms);
+    while(pdpvt) {
+        if(pdpvt->waitRead) {
+            pdpvt->waitRead = 0;
+        } else {
+            pdpvt->update = 1;
+        }
+        callbackRequestProcessCallback(&pdpvt->processCallback,
+            priorityLow,pdpvt->precord);
+        pdpvt = (dpvt *)ellNext(&pdpvt->node);
+    }
+}
+
+/* The records are processed when the data is in place. A trigger that
+ * came during the read starts the next one. After a failed read the
+ * records keep showing the last good set and the set read into is free.
+ */
+static void readDone(void *pvt,gtrStatus status)
+{
+    devGtr *pdevGtr = (devGtr *)pvt;
+    gtrops *pgtrops = pdevGtr->pgtrops;
+    int again;
+
+    if(status!=gtrStatusOK)
+        printf("devGtr: myCallback read failed\n");
+    (*pgtrops->lock)(pdevGtr->gtrpvt);
+    if(status==gtrStatusOK) {
+        pdevGtr->channels.ready = pdevGtr->channels.fill;
+    } else {
+        pdevGtr->channels.fill = pdevGtr->channels.ready;
+    }
+    pdevGtr->reading = 0;
+    again = pdevGtr->pending;
+    pdevGtr->pending = 0;
+    if(pdevGtr->lazy) {
+        pdevGtr->doneSeq = pdevGtr->readSeq;
+        processWaveforms(pdevGtr);
+    }
+    (*pgtrops->unlock)(pdevGtr->gtrpvt);
+    /* In lazy read this is what lets autoRestart rearm the card */
+    scanIoRequest(pdevGtr->ioscanpvt);
+    if(again) requestRead(pdevGtr);
+}
+
+/* A set that is not ready and that no record uses, -1 if there is none.
+ * Called with the card locked.
+ */
+static int freeSet(devGtrChannels *pdevgtrchannels)
+{
+    int set;
+
+    if(pdevgtrchannels->nsets==1) return(0);
+    for(set=0; set<pdevgtrchannels->nsets; set++) {
+        if(set!=pdevgtrchannels->ready && pdevgtrchannels->nuse[set]==0)
+            return(set);
+    }
+    return(-1);
+}
+
+/* A record stops using set. Called with the card locked.
+ * Returns 1 if a read that waited for a free set can now start.
+ */
+static int releaseSet(devGtr *pdevGtr,int set)
+{
+    devGtrChannels *pdevgtrchannels = &pdevGtr->channels;
+
+    pdevgtrchannels->nuse[set]--;
+    if(!pdevgtrchannels->waiting || pdevgtrchannels->nuse[set]>0
+    || set==pdevgtrchannels->ready) return(0);
+    pdevgtrchannels->waiting = 0;
+    return(1);
+}
+
+/* Is the record of pdpvt to be read */
+static int isWanted(dpvt *pdpvt)
+{
+    return(pdpvt->waitRead || !devGtrMonitoredOnly
+        || ellCount(&pdpvt->precord->mlis)>0);
+}
+
+/* Give the channels of set that are to be read their len and the others
+ * len 0. Returns 0, and leaves set as it is, if no channel is to be read.
+ * Called with the card locked.
+ */
+static int readMask(devGtrChannels *pdevgtrchannels,int set)
+{
+    gtrchannel *pachannel = pdevgtrchannels->pachannel[set];
+    dpvt *pdpvt;
+    int ind;
+
+    pdpvt = (dpvt *)ellFirst(&pdevgtrchannels->waveforms);
+    while(pdpvt && !isWanted(pdpvt)) pdpvt = (dpvt *)ellNext(&pdpvt->node);
+    if(!pdpvt) return(0);
+    for(ind=0; ind<pdevgtrchannels->nchannels; ind++) pachannel[ind].len = 0;
+    while(pdpvt) {
+        if(isWanted(pdpvt))
+            pachannel[pdpvt->signal].len = pdevgtrchannels->nelm[pdpvt->signal];
+        pdpvt = (dpvt *)ellNext(&pdpvt->node);
+    }
+    return(1);
+}
+
+/* Starts the read and returns, so that the callback thread is not held
+ * while a driver with startReadMemory moves the data.
+ */
+static void startRead(devGtr *pdevGtr)
+{
+    gtrops *pgtrops = pdevGtr->pgtrops;
+    devGtrChannels *pdevgtrchannels = &pdevGtr->channels;
+    gtrStatus status;
+    int set,ind;
+
+    if(!pdevGtr->channels.hasWaveforms) {
+        scanIoRequest(pdevGtr->ioscanpvt);
+        return;
+    }
+    (*pgtrops->lock)(pdevGtr->gtrpvt);
+    pdevGtr->requested = 0;
+    if(pdevGtr->reading) {
+        pdevGtr->pending = 1;
+        (*pgtrops->unlock)(pdevGtr->gtrpvt);
+        return;
+    }
+    /* All sets are shown. The last record to let go starts the read */
+    set = freeSet(pdevgtrchannels);
+    if(set<0) {
+        pdevgtrchannels->waiting = 1;
+        (*pgtrops->unlock)(pdevGtr->gtrpvt);
+        return;
+    }
+    /* Drivers skip channels with len 0 */
+    if(!readMask(pdevgtrchannels,set)) {
+        if(pdevGtr->lazy) {
+            pdevGtr->doneSeq = pdevGtr->eventSeq;
+            processWaveforms(pdevGtr);
+        }
+        (*pgtrops->unlock)(pdevGtr->gtrpvt);
+        scanIoRequest(pdevGtr->ioscanpvt);
+        return;
+    }
+    pdevgtrchannels->fill = set;
+    pdevGtr->reading = 1;
+    pdevGtr->readSeq = pdevGtr->eventSeq;
+    for(ind=0; ind<pdevgtrchannels->nchannels; ind++) {
+        gtrchannel *pgtrchannel = &pdevgtrchannels->pachannel[set][ind];
+
+        pgtrchannel->scale = pdevgtrchannels->scale[ind];
+        pgtrchannel->offset = pdevgtrchannels->offset[ind];
+    }
+    (*pgtrops->unlock)(pdevGtr->gtrpvt);
+    status = (*pgtrops->startReadMemory)(pdevGtr->gtrpvt,
+        pdevgtrchannels->papgtrchannel[set],readDone,pdevGtr);
+    if(status!=gtrStatusOK) readDone(pdevGtr,status);
+}
+
 static void myCallback(CALLBACK *pcallback)
 {
     devGtr *pdevGtr = 0;
-    gtrops *pgtrops;
-    gtrStatus status;
 
     callbackGetUser(pdevGtr,pcallback);
-    pgtrops = pdevGtr->pgtrops;
-    if(pdevGtr->channels.hasWaveforms) {
-        status = (*pgtrops->readMemory)(pdevGtr->gtrpvt,pdevGtr->channels.papgtrchannel);
-        if(status!=gtrStatusOK)
-            printf("devGtr: myCallback read failed\n");
+    startRead(pdevGtr);
+}
+
+/* Bind the calling thread to cpu. Returns -1 if that can not be done */
+static int setAffinity(int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu,&set);
+    return(pthread_setaffinity_np(pthread_self(),sizeof(set),&set) ? -1 : 0);
+#elif defined(vxWorks) && defined(_WRS_CONFIG_SMP)
+    cpuset_t set;
+
+    CPUSET_ZERO(set);
+    CPUSET_SET(set,cpu);
+    return((taskCpuAffinitySet(taskIdSelf(),set)==OK) ? 0 : -1);
+#else
+    return(-1);
+#endif
+}
+
+static void readThread(void *pvt)
+{
+    devGtr *pdevGtr = (devGtr *)pvt;
+
+    if(pdevGtr->cpu>=0 && setAffinity(pdevGtr->cpu))
+        printf("%s: can not run on cpu %d\n",
+            epicsThreadGetNameSelf(),pdevGtr->cpu);
+    while(1) {
+        epicsEventMustWait(pdevGtr->readEvent);
+        startRead(pdevGtr);
+    }
+}
+
+/* Start the readout thread of card if one was asked for */
+static void createReadThread(devGtr *pdevGtr,int card)
+{
+    readThreadConfig *pconfig;
+    char name[20];
+
+    pconfig = (readThreadConfig *)ellFirst(&readThreadList);
+    while(pconfig) {
+        if(pconfig->card==card) break;
+        pconfig = (readThreadConfig *)ellNext(&pconfig->node);
+    }
+    if(!pconfig) return;
+    pdevGtr->cpu = pconfig->cpu;
+    pdevGtr->readEvent = epicsEventMustCreate(epicsEventEmpty);
+    sprintf(name,"gtrRead%d",card);
+    pdevGtr->readThread = epicsThreadCreate(name,pconfig->priority,
+        pconfig->stackSize,readThread,pdevGtr);
+    if(!pdevGtr->readThread) {
+        printf("devGtr: epicsThreadCreate %s failed\n",name);
+        epicsEventDestroy(pdevGtr->readEvent);
+        pdevGtr->readEvent = 0;
     }
-    scanIoRequest(pdevGtr->ioscanpvt);
 }
 
 static void interruptHandler(void *pvt)
 {
     devGtr *pdevGtr = (devGtr *)pvt;
 
-    callbackRequest(&pdevGtr->callback);
+    if(pdevGtr->lazy && pdevGtr->channels.hasWaveforms) {
+        pdevGtr->eventSeq++;
+        return;
+    }
+    requestRead(pdevGtr);
 }
 
 static long get_ioint_info(int cmd, dbCommon *precord, IOSCANPVT *pvt)
@@ -208,21 +532,103 @@ static long get_ioint_info(int cmd, dbCommon *precord, IOSCANPVT *pvt)
     *pvt = pdevGtr->ioscanpvt;
     return(0);
 }
+
+/* In lazy read every read processes the waveform records, so I/O Intr
+ * does not add them to the list of the card.
+ */
+static long waveform_get_ioint_info(int cmd,dbCommon *precord,IOSCANPVT *pvt)
+{
+    dpvt *pdpvt;
+    devGtr *pdevGtr;
+
+    pdpvt = precord->dpvt;
+    if(!pdpvt) return(-1);
+    pdevGtr = pdpvt->pdevGtr;
+    *pvt = pdevGtr->lazy ? pdevGtr->waveformscanpvt : pdevGtr->ioscanpvt;
+    return(0);
+}
 
 static void
 allocateChannels(devGtrChannels *pdevgtrchannels, int nchannels)
 {
-    int ind;
+    int ind,set;
 
     pdevgtrchannels->nchannels = nchannels;
-    if(pdevgtrchannels->nchannels != 0) {
-        pdevgtrchannels->pachannel = calloc(pdevgtrchannels->nchannels,sizeof(gtrchannel));
-        pdevgtrchannels->papgtrchannel = calloc(pdevgtrchannels->nchannels,sizeof(gtrchannel *));
+    pdevgtrchannels->nsets = devGtrBufferSets;
+    if(pdevgtrchannels->nsets<1) pdevgtrchannels->nsets = 1;
+    if(pdevgtrchannels->nsets>MAXSETS) pdevgtrchannels->nsets = MAXSETS;
+    if(pdevgtrchannels->nchannels == 0) return;
+    pdevgtrchannels->gain = dbCalloc(nchannels,sizeof(double));
+    pdevgtrchannels->calOffset = dbCalloc(nchannels,sizeof(double));
+    pdevgtrchannels->scale = dbCalloc(nchannels,sizeof(double));
+    pdevgtrchannels->offset = dbCalloc(nchannels,sizeof(double));
+    pdevgtrchannels->nelm = dbCalloc(nchannels,sizeof(int));
+    for(set=0; set<pdevgtrchannels->nsets; set++) {
+        gtrchannel *pachannel;
+        gtrchannel **papgtrchannel;
+
+        pachannel = calloc(pdevgtrchannels->nchannels,sizeof(gtrchannel));
+        papgtrchannel = calloc(pdevgtrchannels->nchannels,sizeof(gtrchannel *));
         for(ind=0;ind<pdevgtrchannels->nchannels; ind++)
-            pdevgtrchannels->papgtrchannel[ind] = &pdevgtrchannels->pachannel[ind];
+            papgtrchannel[ind] = &pachannel[ind];
+        pdevgtrchannels->pachannel[set] = pachannel;
+        pdevgtrchannels->papgtrchannel[set] = papgtrchannel;
+    }
+}
+
+/* Compute scale and offset of all channels. Called with the card locked */
+static void computeScale(devGtr *pdevGtr)
+{
+    devGtrChannels *pdevgtrchannels = &pdevGtr->channels;
+    epicsInt32 rawLow,rawHigh;
+    double scale = 1.0;
+    double offset = 0.0;
+    int ind;
+
+    (*pdevGtr->pgtrops->getLimits)(pdevGtr->gtrpvt,&rawLow,&rawHigh);
+    if(rawLow!=rawHigh) {
+        scale = 1.0/((double)rawHigh - (double)rawLow);
+        offset = -(double)rawLow*scale;
+    }
+    for(ind=0; ind<pdevgtrchannels->nchannels; ind++) {
+        pdevgtrchannels->scale[ind] = pdevgtrchannels->gain[ind]*scale;
+        pdevgtrchannels->offset[ind] = pdevgtrchannels->gain[ind]*offset
+            + pdevgtrchannels->calOffset[ind];
     }
 }
 
+/* Give the channels of card the calibration loaded for it, if any.
+ * Called with the card locked.
+ */
+static void applyCalibration(devGtr *pdevGtr,int card)
+{
+    devGtrChannels *pdevgtrchannels = &pdevGtr->channels;
+    calibrationConfig *pconfig;
+    int ind;
+
+    pconfig = (calibrationConfig *)ellFirst(&calibrationList);
+    while(pconfig) {
+        if(pconfig->card==card) break;
+        pconfig = (calibrationConfig *)ellNext(&pconfig->node);
+    }
+    for(ind=0; ind<pdevgtrchannels->nchannels; ind++) {
+        pdevgtrchannels->gain[ind] = 1.0;
+        pdevgtrchannels->calOffset[ind] = 0.0;
+    }
+    if(pconfig) for(ind=0; ind<pconfig->nentries; ind++) {
+        calibrationEntry *pentry = &pconfig->pentry[ind];
+
+        if(pentry->signal>=pdevgtrchannels->nchannels) {
+            printf("devGtr: card %d has no signal %d to calibrate\n",
+                card,pentry->signal);
+            continue;
+        }
+        pdevgtrchannels->gain[pentry->signal] = pentry->gain;
+        pdevgtrchannels->calOffset[pentry->signal] = pentry->offset;
+    }
+    computeScale(pdevGtr);
+}
+
 static dpvt *common_init_record(dbCommon *precord,DBLINK *plink,
     char **parmString,int nparmStrings)
 {
@@ -255,8 +661,12 @@ static dpvt *common_init_record(dbCommon *precord,DBLINK *plink,
         callbackSetCallback(myCallback,&pdevGtr->callback);
         callbackSetUser(pdevGtr,&pdevGtr->callback);
         callbackSetPriority(priorityLow,&pdevGtr->callback);
+        createReadThread(pdevGtr,pvmeio->card);
+        pdevGtr->lazy = devGtrLazyRead;
+        if(pdevGtr->channels.nchannels>0) applyCalibration(pdevGtr,pvmeio->card);
         (*pgtrops->registerHandler)(gtrpvt,interruptHandler,pdevGtr);
         scanIoInit(&pdevGtr->ioscanpvt);
+        scanIoInit(&pdevGtr->waveformscanpvt);
         (*pgtrops->setUser)(gtrpvt,pdevGtr);
     }
     (*pgtrops->unlock)(gtrpvt);
@@ -279,6 +689,7 @@ static dpvt *common_init_record(dbCommon *precord,DBLINK *plink,
     }
     pdpvt = dbCalloc(1,sizeof(dpvt));
     pdpvt->pdevGtr = pdevGtr;
+    pdpvt->precord = precord;
     pdpvt->parm = ind;
     precord->dpvt = pdpvt;
     return(pdpvt);
@@ -508,6 +919,42 @@ static long stringin_init_record(dbCommon *precord)
 static long stringin_read(dbCommon *precord)
 { return(0);}
 
+/* The record of signal that is read in place, NULL if there is none */
+static dpvt *inPlaceRecord(devGtrChannels *pdevgtrchannels,int signal)
+{
+    dpvt *pdpvt;
+
+    pdpvt = (dpvt *)ellFirst(&pdevgtrchannels->waveforms);
+    while(pdpvt) {
+        if(pdpvt->signal==signal && pdpvt->isPdataBptr) return(pdpvt);
+        pdpvt = (dpvt *)ellNext(&pdpvt->node);
+    }
+    return(0);
+}
+
+/* A record that can not share what is read in place is added to signal.
+ * A record that was read in place copies from an epicsInt16 buffer from
+ * now on. Called by
+ * waveform_init_record, before any read, with the card locked.
+ */
+static void notInPlace(devGtrChannels *pdevgtrchannels,int signal)
+{
+    dpvt *pdpvt = inPlaceRecord(pdevgtrchannels,signal);
+    int set;
+
+    if(!pdpvt) return;
+    pdevgtrchannels->nuse[pdpvt->set]--;
+    pdpvt->isPdataBptr = 0;
+    for(set=0; set<pdevgtrchannels->nsets; set++) {
+        gtrchannel *pgtrchannel = &pdevgtrchannels->pachannel[set][signal];
+
+        /* Set 0 is the bptr of the record */
+        if(set>0) free(pgtrchannel->pdata);
+        pgtrchannel->pdata = dbCalloc(pgtrchannel->len,sizeof(epicsInt16));
+        pgtrchannel->ftvl = menuFtypeSHORT;
+    }
+}
+
 static long waveform_init_record(dbCommon *precord)
 {
     waveformRecord *pwaveformRecord = (waveformRecord *)precord;
@@ -520,7 +967,9 @@ static long waveform_init_record(dbCommon *precord)
     gtrchannel *pgtrchannel;
     devGtrChannels *pdevgtrchannels;
     int signal;
+    int set;
     int ftvl = pwaveformRecord->ftvl;
+    int scaled,inPlace;
     epicsInt32 rawLow,rawHigh;
 
     pdpvt = common_init_record(precord,&pwaveformRecord->inp,
@@ -554,8 +1003,6 @@ static long waveform_init_record(dbCommon *precord)
 
     case menuFtypeFLOAT:
     case menuFtypeDOUBLE:
-        pwaveformRecord->hopr = 1.0;
-        pwaveformRecord->lopr = 0.0;
         break;
     }
     pvmeio = &(pwaveformRecord->inp.value.vmeio);
@@ -568,25 +1015,100 @@ static long waveform_init_record(dbCommon *precord)
         pwaveformRecord->pact = 1;
         return(status);
     }
+    scaled = (ftvl==menuFtypeFLOAT)||(ftvl==menuFtypeDOUBLE);
+    if(scaled) {
+        double gain = pdevgtrchannels->gain[signal];
+        double calOffset = pdevgtrchannels->calOffset[signal];
+
+        pwaveformRecord->hopr = (gain>0.0) ? gain + calOffset : calOffset;
+        pwaveformRecord->lopr = (gain>0.0) ? calOffset : gain + calOffset;
+    }
     pdpvt->signal = pvmeio->signal;
-    pgtrchannel = &pdevgtrchannels->pachannel[pdpvt->signal];
-    if(((ftvl==menuFtypeSHORT)||(ftvl==menuFtypeLONG)||(rawLow==rawHigh)) && !pgtrchannel->pdata) {
-        pgtrchannel->pdata = pwaveformRecord->bptr;
-        pgtrchannel->len = pwaveformRecord->nelm;
-        pgtrchannel->ftvl = ftvl;
-        pdpvt->isPdataBptr = 1;
-    } else if(!pgtrchannel->pdata || pgtrchannel->len<pwaveformRecord->nelm) {
-        if(pgtrchannel->pdata && !pdpvt->isPdataBptr) free(pgtrchannel->pdata);
-        pdpvt->isPdataBptr = 0;
-        pgtrchannel->pdata = dbCalloc(pwaveformRecord->nelm, sizeof(epicsInt16));
-        pgtrchannel->len = pwaveformRecord->nelm;
-        pgtrchannel->ftvl = menuFtypeSHORT;
+    /* FLOAT and DOUBLE are read in place if the driver scales them */
+    inPlace = (ftvl==menuFtypeSHORT)||(ftvl==menuFtypeLONG)||(rawLow==rawHigh)
+        || (scaled && (*pgtrops->readsFloat)(gtrpvt));
+    /* Another record of the signal copies what is read. If its FTVL
+     * differs, or it needs more elements than are read in place, the
+     * signal is read as epicsInt16 for all of them. LONG holds the packed
+     * words, which can not be shared that way.
+     */
+    pgtrchannel = &pdevgtrchannels->pachannel[0][signal];
+    if(pgtrchannel->pdata) {
+        if(ftvl!=pgtrchannel->ftvl
+        && (ftvl==menuFtypeLONG || pgtrchannel->ftvl==menuFtypeLONG)) {
+            status = S_db_badField;
+            recGblRecordError(status,(void *)precord,
+                "devGtr FTVL LONG can not share a signal with other FTVLs");
+            pwaveformRecord->pact = 1;
+            return(status);
+        }
+        if(ftvl!=pgtrchannel->ftvl || (ftvl!=menuFtypeLONG
+        && pgtrchannel->len<pwaveformRecord->nelm)) {
+            (*pgtrops->lock)(gtrpvt);
+            notInPlace(pdevgtrchannels,signal);
+            (*pgtrops->unlock)(gtrpvt);
+        }
+        inPlace = 0;
     }
+    /* Set 0 of a record read in place is the bptr of the record */
+    for(set=0; set<pdevgtrchannels->nsets; set++) {
+        pgtrchannel = &pdevgtrchannels->pachannel[set][signal];
+        if(inPlace) {
+            pgtrchannel->pdata = (set==0) ? pwaveformRecord->bptr
+                : dbCalloc(pwaveformRecord->nelm,dbValueSize(ftvl));
+            pgtrchannel->len = pwaveformRecord->nelm;
+            pgtrchannel->ftvl = ftvl;
+            pdpvt->isPdataBptr = 1;
+        } else if(!pgtrchannel->pdata) {
+            pgtrchannel->pdata = dbCalloc(pwaveformRecord->nelm, sizeof(epicsInt16));
+            pgtrchannel->len = pwaveformRecord->nelm;
+            pgtrchannel->ftvl = menuFtypeSHORT;
+        } else if(pgtrchannel->len<pwaveformRecord->nelm
+        && !inPlaceRecord(pdevgtrchannels,signal)) {
+            free(pgtrchannel->pdata);
+            pgtrchannel->pdata = dbCalloc(pwaveformRecord->nelm, sizeof(epicsInt16));
+            pgtrchannel->len = pwaveformRecord->nelm;
+        }
+    }
+    (*pgtrops->lock)(gtrpvt);
+    if(pdpvt->isPdataBptr) pdevgtrchannels->nuse[0]++;
+    pdevgtrchannels->nelm[pdpvt->signal] =
+        pdevgtrchannels->pachannel[0][pdpvt->signal].len;
+    ellAdd(&pdevgtrchannels->waveforms,&pdpvt->node);
+    (*pgtrops->unlock)(gtrpvt);
     precord->dpvt = pdpvt;
     pdevgtrchannels->hasWaveforms=1;
     return(0);
 }
 
+/* Copy or convert the data of a channel that is not read in place.
+ * The channel holds epicsInt16 values unless its FTVL is that of the record.
+ */
+static void copyChannel(waveformRecord *pwaveformRecord,
+    gtrchannel *pgtrchannel,int ndata,double scale,double offset)
+{
+    if(pgtrchannel->ftvl==pwaveformRecord->ftvl) {
+        memcpy(pwaveformRecord->bptr,pgtrchannel->pdata,
+            ndata*dbValueSize(pwaveformRecord->ftvl));
+    } else if(pwaveformRecord->ftvl == menuFtypeSHORT) {
+        memcpy(pwaveformRecord->bptr,pgtrchannel->pdata,ndata*sizeof(epicsInt16));
+    } else if(pwaveformRecord->ftvl == menuFtypeLONG) {
+        memcpy(pwaveformRecord->bptr,pgtrchannel->pdata,ndata*sizeof(long));
+    } else {
+        if(pwaveformRecord->ftvl==menuFtypeFLOAT) {
+            gtrUnpackScaleFloat(pgtrchannel->pdata,ndata,
+                (float *)pwaveformRecord->bptr,(float)scale,(float)offset);
+        } else if(pwaveformRecord->ftvl==menuFtypeDOUBLE) {
+            gtrUnpackScaleDouble(pgtrchannel->pdata,ndata,
+                (double *)pwaveformRecord->bptr,scale,offset);
+        } else {
+            recGblRecordError(S_db_badField,(void *)pwaveformRecord,
+                "devGtr FTVL must be SHORT, LONG, FLOAT or DOUBLE");
+            pwaveformRecord->pact = 1;
+        }
+    }
+}
+
 static long waveform_read(dbCommon *precord)
 {
     waveformRecord *pwaveformRecord = (waveformRecord *)precord;
@@ -596,6 +1118,10 @@ static long waveform_read(dbCommon *precord)
     gtrops *pgtrops;
     long status;
     int ndata;
+    int set;
+    int again = 0;
+    int skipped;
+    double scale,offset;
     gtrchannel *pgtrchannel;
     devGtrChannels *pdevgtrchannels;
 
@@ -614,42 +1140,197 @@ static long waveform_read(dbCommon *precord)
     case readData:     pdevgtrchannels=&pdevGtr->channels;     break;
     default:           return(S_db_badField);
     }
-    pgtrchannel = &pdevgtrchannels->pachannel[pdpvt->signal];
+    /* Lazy read: wait for a read if there was an event since the last one.
+     * A read that is under way is shared.
+     */
+    (*pgtrops->lock)(gtrpvt);
+    if(pdevGtr->lazy && !precord->pact && !pdpvt->update
+    && pdevGtr->doneSeq!=pdevGtr->eventSeq) {
+        int start = !pdevGtr->reading && !pdevGtr->requested;
+
+        pdpvt->waitRead = 1;
+        precord->pact = 1;
+        if(start) pdevGtr->requested = 1;
+        (*pgtrops->unlock)(gtrpvt);
+        if(start) requestRead(pdevGtr);
+        return(0);
+    }
+    pdpvt->update = 0;
+    /* Show the newest set. The driver does not read into it while the
+     * record shows or copies it.
+     */
+    set = pdevgtrchannels->ready;
+    pgtrchannel = &pdevgtrchannels->pachannel[set][pdpvt->signal];
+    skipped = (pgtrchannel->len==0);
+    scale = pdevgtrchannels->scale[pdpvt->signal];
+    offset = pdevgtrchannels->offset[pdpvt->signal];
+    if(!pdpvt->isPdataBptr) {
+        if(!skipped) pdevgtrchannels->nuse[set]++;
+    } else if(pdpvt->set!=set) {
+        pdevgtrchannels->nuse[set]++;
+        again = releaseSet(pdevGtr,pdpvt->set);
+        pdpvt->set = set;
+        pwaveformRecord->bptr = pgtrchannel->pdata;
+    }
+    (*pgtrops->unlock)(gtrpvt);
+    if(again) requestRead(pdevGtr);
+    /* A channel that nobody monitors was not read and has no elements */
+    if(skipped) {
+        pwaveformRecord->nord = 0;
+        return(0);
+    }
     ndata = pgtrchannel->ndata;
     if(ndata>pwaveformRecord->nelm) ndata = pwaveformRecord->nelm;
     if(ndata>0 ) {
         pwaveformRecord->nord = ndata;
     } else {
         recGblSetSevr(precord,STATE_ALARM,MINOR_ALARM);
+    }
+    if(pdpvt->isPdataBptr) return(0);
+    if(ndata>0) copyChannel(pwaveformRecord,pgtrchannel,ndata,scale,offset);
+    (*pgtrops->lock)(gtrpvt);
+    again = releaseSet(pdevGtr,set);
+    (*pgtrops->unlock)(gtrpvt);
+    if(again) requestRead(pdevGtr);
+    return(0);
+}
+
+int devGtrReadThreadConfig(int card,int priority,int stackSize,int cpu)
+{
+    readThreadConfig *pconfig;
+
+    pconfig = calloc(1,sizeof(readThreadConfig));
+    if(!pconfig) {
+        printf("devGtrReadThreadConfig: calloc failed\n");
         return(0);
     }
-    if(pwaveformRecord->bptr==pgtrchannel->pdata) return(0);
-    if(pwaveformRecord->ftvl == menuFtypeSHORT) {
-        memcpy(pwaveformRecord->bptr,pgtrchannel->pdata,ndata*sizeof(epicsInt16));
-    } else if(pwaveformRecord->ftvl == menuFtypeLONG) {
-        memcpy(pwaveformRecord->bptr,pgtrchannel->pdata,ndata*sizeof(long));
-    } else {
-        epicsInt32 rawLow,rawHigh;
-        epicsInt16 *pfrom = pgtrchannel->pdata;
-        int ind;
-        (*pgtrops->getLimits)(gtrpvt,&rawLow,&rawHigh);
-        if(pwaveformRecord->ftvl==menuFtypeFLOAT) {
-            float *pto = (float *)pwaveformRecord->bptr;
-            float low,high,diff;
-            low = (float)rawLow; high = (float)rawHigh; diff = high - low;
-            for(ind=0; ind<ndata; ind++)
-                *pto++ = ((float)(*pfrom++) -low)/diff;
-        } else if(pwaveformRecord->ftvl==menuFtypeDOUBLE) {
-            double *pto = (double *)pwaveformRecord->bptr;
-            double low,high,diff;
-            low = (double)rawLow; high = (double)rawHigh; diff = high - low;
-            for(ind=0; ind<ndata; ind++)
-                *pto++ = ((double)(*pfrom++) -low)/diff;
-        } else {
-            recGblRecordError(S_db_badField,(void *)precord,
-                "devGtr FTVL must be SHORT, LONG, FLOAT or DOUBLE");
-            pwaveformRecord->pact = 1;
+    pconfig->card = card;
+    pconfig->priority = (priority>0) ? priority : epicsThreadPriorityHigh;
+    pconfig->stackSize = (stackSize>0) ? stackSize
+        : epicsThreadGetStackSize(epicsThreadStackMedium);
+    pconfig->cpu = cpu;
+    ellAdd(&readThreadList,&pconfig->node);
+    return(0);
+}
+
+/* Read a calibration file of lines "signal gain offset" for card.
+ * Blank lines and lines starting with # are skipped. If the card is
+ * already in use the new calibration is used from the next read on.
+ */
+int devGtrCalibration(int card,const char *filename)
+{
+    calibrationConfig *pconfig;
+    calibrationEntry *pentry = 0;
+    int nentries = 0;
+    int line = 0;
+    char buffer[200];
+    FILE *fp;
+    gtrPvt gtrpvt;
+    gtrops *pgtrops;
+
+    if(!filename) {
+        printf("devGtrCalibration: no file\n");
+        return(0);
+    }
+    fp = fopen(filename,"r");
+    if(!fp) {
+        printf("devGtrCalibration: can not open %s\n",filename);
+        return(0);
+    }
+    while(fgets(buffer,sizeof(buffer),fp)) {
+        calibrationEntry entry;
+        calibrationEntry *pnew;
+        char *pstart = buffer;
+
+        line++;
+        while(*pstart==' ' || *pstart=='\t') pstart++;
+        if(*pstart=='#' || *pstart=='\n' || *pstart==0) continue;
+        if(sscanf(pstart,"%d %lf %lf",&entry.signal,&entry.gain,&entry.offset)!=3
+        || entry.signal<0) {
+            printf("devGtrCalibration: %s line %d is not signal gain offset\n",
+                filename,line);
+            continue;
+        }
+        pnew = realloc(pentry,(nentries+1)*sizeof(calibrationEntry));
+        if(!pnew) {
+            printf("devGtrCalibration: realloc failed\n");
+            free(pentry);
+            fclose(fp);
+            return(0);
+        }
+        pentry = pnew;
+        pentry[nentries++] = entry;
+    }
+    fclose(fp);
+    pconfig = (calibrationConfig *)ellFirst(&calibrationList);
+    while(pconfig) {
+        if(pconfig->card==card) break;
+        pconfig = (calibrationConfig *)ellNext(&pconfig->node);
+    }
+    if(!pconfig) {
+        pconfig = calloc(1,sizeof(calibrationConfig));
+        if(!pconfig) {
+            printf("devGtrCalibration: calloc failed\n");
+            free(pentry);
+            return(0);
         }
+        pconfig->card = card;
+        ellAdd(&calibrationList,&pconfig->node);
+    }
+    gtrpvt = gtrFind(card,&pgtrops);
+    if(gtrpvt) (*pgtrops->lock)(gtrpvt);
+    free(pconfig->pentry);
+    pconfig->pentry = pentry;
+    pconfig->nentries = nentries;
+    if(gtrpvt) {
+        devGtr *pdevGtr = (*pgtrops->getUser)(gtrpvt);
+
+        if(pdevGtr && pdevGtr->channels.nchannels>0)
+            applyCalibration(pdevGtr,card);
+        (*pgtrops->unlock)(gtrpvt);
     }
     return(0);
 }
+
+/*
+ * IOC shell command registration
+ */
+#include <iocsh.h>
+static const iocshArg devGtrReadThreadConfigArg0 = { "card",iocshArgInt};
+static const iocshArg devGtrReadThreadConfigArg1 = { "priority",iocshArgInt};
+static const iocshArg devGtrReadThreadConfigArg2 = { "stackSize",iocshArgInt};
+static const iocshArg devGtrReadThreadConfigArg3 = { "cpu",iocshArgInt};
+static const iocshArg *devGtrReadThreadConfigArgs[] = {
+    &devGtrReadThreadConfigArg0, &devGtrReadThreadConfigArg1,
+    &devGtrReadThreadConfigArg2, &devGtrReadThreadConfigArg3};
+static const iocshFuncDef devGtrReadThreadConfigFuncDef =
+                      {"devGtrReadThreadConfig",4,devGtrReadThreadConfigArgs};
+static void devGtrReadThreadConfigCallFunc(const iocshArgBuf *args)
+{
+    devGtrReadThreadConfig(args[0].ival, args[1].ival,
+        args[2].ival, args[3].ival);
+}
+
+static const iocshArg devGtrCalibrationArg0 = { "card",iocshArgInt};
+static const iocshArg devGtrCalibrationArg1 = { "filename",iocshArgString};
+static const iocshArg *devGtrCalibrationArgs[] = {
+    &devGtrCalibrationArg0, &devGtrCalibrationArg1};
+static const iocshFuncDef devGtrCalibrationFuncDef =
+                      {"devGtrCalibration",2,devGtrCalibrationArgs};
+static void devGtrCalibrationCallFunc(const iocshArgBuf *args)
+{
+    devGtrCalibration(args[0].ival, args[1].sval);
+}
+
+static void
+devGtrRegisterCommands(void)
+{
+    static int firstTime = 1;
+    if (firstTime) {
+        iocshRegister(&devGtrReadThreadConfigFuncDef,
+            devGtrReadThreadConfigCallFunc);
+        iocshRegister(&devGtrCalibrationFuncDef,devGtrCalibrationCallFunc);
+        firstTime = 0;
+    }
+}
+epicsExportRegistrar(devGtrRegisterCommands);
@@ -316,6 +316,33 @@ STATIC void gtrunlock(gtrPvt pvt)
     epicsMutexUnlock(pgtrInfo->lock);
 }
 
+STATIC gtrStatus gtrstartReadMemory(gtrPvt pvt, gtrchannel **papgtrchannel,
+    gtrReadDone done,void *donePvt)
+{
+    gtrInfo *pgtrInfo = (gtrInfo *)pvt;
+    gtrStatus status;
+    
+    if(pgtrInfo->pgtrdrvops->startReadMemory) {
+        return (*pgtrInfo->pgtrdrvops->startReadMemory)(
+            pgtrInfo->drvPvt,papgtrchannel,done,donePvt);
+    } else if(pgtrInfo->pgtrdrvops->readMemory) {
+        status = (*pgtrInfo->pgtrdrvops->readMemory)(
+            pgtrInfo->drvPvt,papgtrchannel);
+        (*done)(donePvt,status);
+        return(gtrStatusOK);
+    } else {
+        return(gtrStatusError);
+    }
+}
+
+STATIC int gtrreadsFloat(gtrPvt pvt)
+{
+    gtrInfo *pgtrInfo = (gtrInfo *)pvt;
+
+    if(!pgtrInfo->pgtrdrvops->readsFloat) return(0);
+    return (*pgtrInfo->pgtrdrvops->readsFloat)(pgtrInfo->drvPvt);
+}
+
 static gtrops ops = {
 gtrinit,
 gtrreport,
@@ -341,7 +368,9 @@ gtrname,
 gtrsetUser,
 gtrgetUser,
 gtrlock,
-gtrunlock
+gtrunlock,
+gtrstartReadMemory,
+gtrreadsFloat
 };
 
 gtrPvt gtrFind(int card,gtrops **ppgtrops)
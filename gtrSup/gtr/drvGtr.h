@@ -29,8 +29,15 @@ typedef struct gtrchannel {
     int ndata; /*number of elements readMemory put into array*/
     void *pdata;
     int ftvl;
+    /* FLOAT and DOUBLE channels of drivers whose readsFloat returns
+     * non zero get raw*scale + offset */
+    double scale;
+    double offset;
 }gtrchannel;
 
+/* Called by startReadMemory when the data is in place */
+typedef void (*gtrReadDone)(void *donePvt,gtrStatus status);
+
 typedef struct gtrops {
     void      (*init)(gtrPvt pvt);
     void      (*report)(gtrPvt pvt,int level);
@@ -61,6 +68,19 @@ typedef struct gtrops {
     void      *(*getUser)(gtrPvt pvt);
     void      (*lock)(gtrPvt pvt);
     void      (*unlock)(gtrPvt pvt);
+    /* Split form of readMemory. Returns at once and calls done, from any
+     * thread but not from interrupt level, when papgtrchannel is filled.
+     * done is not called if it does not return gtrStatusOK.
+     * drvGtr calls readMemory and then done for drivers without it,
+     * which is all but drvGtrSim; the VME drivers read synchronously.
+     */
+    gtrStatus (*startReadMemory)(gtrPvt pvt, gtrchannel **papgtrchannel,
+        gtrReadDone done,void *donePvt);
+    /* Non zero if FLOAT and DOUBLE channels are filled with scaled values.
+     * Otherwise they must be given as SHORT channels and converted.
+     * drvGtr returns 0 for drivers without it.
+     */
+    int       (*readsFloat)(gtrPvt pvt);
 }gtrops;
 
 gtrPvt gtrFind(int card,gtrops **ppgtrops);
@@ -68,6 +88,11 @@ gtrPvt gtrFind(int card,gtrops **ppgtrops);
 void gtrRegisterDriver(int card,
     const char *name,gtrops *pgtrdrvops,gtrPvt drvPvt);
 
+#if !defined(vxWorks) && !defined(__rtems__)
+/* The VME BSPs supply this. On the host it is provided by gtrMockVme */
+void bcopyLongs(char *source,char *destination,int nlongs);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -1,117 +1,808 @@
 #include <epicsDma.h>
 #include <epicsVersion.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <errno.h>
 
 #if ((EPICS_VERSION > 3) || (EPICS_REVISION >= 14))
 
 # include <epicsEvent.h>
+# include <epicsInterrupt.h>
+# include <epicsThread.h>
+# include <epicsTime.h>
 
 #else
 
 # include <vxWorks.h>
 # include <semLib.h>
+# include <intLib.h>
+# include <taskLib.h>
+# include <tickLib.h>
+# include <sysLib.h>
 /*# include <memLib.h>*/
 # define epicsEventId SEM_ID
 # define epicsEventCreate(x) semBCreate(SEM_Q_FIFO, SEM_EMPTY)
 # define epicsEventWait(x) semTake(x, WAIT_FOREVER)
+# define epicsEventWaitWithTimeout(x,t) semTake(x, (int)((t) * sysClkRateGet()) + 1)
+# define epicsEventWaitOK OK
 # define epicsEventSignal(x) semGive(x)
+# define epicsInterruptLock() intLock()
+# define epicsInterruptUnlock(x) intUnlock(x)
 
 #endif
 
 /*
  * Don't cause linker errors if BSP fails to supply these routines
  */
-#ifndef HAS_UNIVERSEDMA
+#ifdef HAS_UNIVERSEDMA
+/* drvUniverseDma.h typedefs the names of the BSP routines declared below */
+#define sysDmaCreate universeSysDmaCreate
+#define sysDmaStatus universeSysDmaStatus
+#define sysDmaToVme universeSysDmaToVme
+#define sysDmaFromVme universeSysDmaFromVme
+#include <drvUniverseDma.h>
+#undef sysDmaCreate
+#undef sysDmaStatus
+#undef sysDmaToVme
+#undef sysDmaFromVme
+#else
 #ifndef vxWorks
 typedef void (*VOIDFUNCPTR)(void *);
 typedef unsigned long   UINT32;
 #endif
+#endif
 #pragma weak sysDmaCreate
 #pragma weak sysDmaStatus
 #pragma weak sysDmaToVme
 #pragma weak sysDmaFromVme
-typedef struct dmaRequest *DMA_ID;
-DMA_ID sysDmaCreate(VOIDFUNCPTR callback, void *context);
-int sysDmaStatus(DMA_ID dmaId);
-int sysDmaToVme(DMA_ID dmaId, UINT32 vmeAddr, int adrsSpace,
+#pragma weak sysDmaModes
+#pragma weak sysDmaListFromVme
+#pragma weak sysDmaAbort
+struct dmaRequest *sysDmaCreate(VOIDFUNCPTR callback, void *context);
+int sysDmaStatus(struct dmaRequest *dmaId);
+int sysDmaToVme(struct dmaRequest *dmaId, UINT32 vmeAddr, int adrsSpace,
                               void *pLocal, int length, int dataWidth);
-int sysDmaFromVme(DMA_ID dmaId, void *pLocal, UINT32 vmeAddr,
+int sysDmaFromVme(struct dmaRequest *dmaId, void *pLocal, UINT32 vmeAddr,
                                 int adrsSpace, int length, int dataWidth);
-static DMA_ID (*psysDmaCreate)(VOIDFUNCPTR callback, void *context) = sysDmaCreate;
-static int (*psysDmaStatus)(DMA_ID dmaId) = sysDmaStatus;
-static int (*psysDmaToVme)(DMA_ID dmaId, UINT32 vmeAddr, int adrsSpace,
-              void *pLocal, int length, int dataWidth) = sysDmaToVme;
-static int (*psysDmaFromVme)(DMA_ID dmaId, void *pLocal, UINT32 vmeAddr,
-              int adrsSpace, int length, int dataWidth) = sysDmaFromVme;
+/*
+ * Optional. A BSP that supports more than BLT32 returns the
+ * epicsDmaModeMask of its modes.
+ */
+int sysDmaModes(void);
+/*
+ * Optional. A BSP with linked list DMA starts the whole list and calls
+ * the callback once at the end.
+ */
+int sysDmaListFromVme(struct dmaRequest *dmaId, const epicsDmaDesc *pdesc,
+                      int ndesc);
+/*
+ * Optional. Stops the transfer in progress, which then ends with an error
+ * and the callback.
+ */
+int sysDmaAbort(struct dmaRequest *dmaId);
+static struct dmaRequest *(*psysDmaCreate)(VOIDFUNCPTR callback,
+              void *context) = sysDmaCreate;
+static int (*psysDmaStatus)(struct dmaRequest *dmaId) = sysDmaStatus;
+static int (*psysDmaToVme)(struct dmaRequest *dmaId, UINT32 vmeAddr,
+              int adrsSpace, void *pLocal, int length,
+              int dataWidth) = sysDmaToVme;
+static int (*psysDmaFromVme)(struct dmaRequest *dmaId, void *pLocal,
+              UINT32 vmeAddr, int adrsSpace, int length,
+              int dataWidth) = sysDmaFromVme;
+static int (*psysDmaModes)(void) = sysDmaModes;
+static int (*psysDmaListFromVme)(struct dmaRequest *dmaId,
+              const epicsDmaDesc *pdesc, int ndesc) = sysDmaListFromVme;
+static int (*psysDmaAbort)(struct dmaRequest *dmaId) = sysDmaAbort;
+
+/*
+ * The BSP routines as an epicsDmaBackend
+ */
+static void *
+bspCreate(epicsDmaCallback_t callback, void *context)
+{
+    return (*psysDmaCreate)(callback, context);
+}
+
+static int
+bspStatus(void *id)
+{
+    return (*psysDmaStatus)((struct dmaRequest *)id);
+}
+
+static int
+bspToVme(void *id, epicsUInt32 vmeAddr, int adrsSpace,
+         void *pLocal, int length, int dataWidth)
+{
+    return (*psysDmaToVme)((struct dmaRequest *)id, vmeAddr, adrsSpace,
+                           pLocal, length, dataWidth);
+}
+
+static int
+bspFromVme(void *id, void *pLocal, epicsUInt32 vmeAddr,
+           int adrsSpace, int length, int dataWidth)
+{
+    return (*psysDmaFromVme)((struct dmaRequest *)id, pLocal, vmeAddr,
+                             adrsSpace, length, dataWidth);
+}
+
+static int
+bspModes(void)
+{
+    return (*psysDmaModes)();
+}
+
+static int
+bspListFromVme(void *id, const epicsDmaDesc *pdesc, int ndesc)
+{
+    return (*psysDmaListFromVme)((struct dmaRequest *)id, pdesc, ndesc);
+}
+
+static int
+bspAbort(void *id)
+{
+    return (*psysDmaAbort)((struct dmaRequest *)id);
+}
+
+static epicsDmaBackend bspBackend;
+
+/*
+ * Return the BSP backend or NULL if the BSP has no DMA.
+ * The optional routines are only set if the BSP has them.
+ */
+static const epicsDmaBackend *
+bspBackendGet(void)
+{
+    if ((psysDmaCreate == NULL)
+     || (psysDmaStatus == NULL)
+     || (psysDmaToVme == NULL)
+     || (psysDmaFromVme == NULL))
+        return NULL;
+    bspBackend.name = "sysDma";
+    bspBackend.create = bspCreate;
+    bspBackend.status = bspStatus;
+    bspBackend.toVme = bspToVme;
+    bspBackend.fromVme = bspFromVme;
+    bspBackend.modes = (psysDmaModes != NULL) ? bspModes : NULL;
+    bspBackend.listFromVme = (psysDmaListFromVme != NULL) ? bspListFromVme : NULL;
+    bspBackend.abort = (psysDmaAbort != NULL) ? bspAbort : NULL;
+    return &bspBackend;
+}
+
+#ifdef HAS_UNIVERSEDMA
+/*
+ * The Universe II driver as an epicsDmaBackend
+ */
+static void *
+universeCreate(epicsDmaCallback_t callback, void *context)
+{
+    return universeDmaCreate(callback, context);
+}
+
+static int
+universeStatus(void *id)
+{
+    return universeDmaStatus((DMA_ID)id);
+}
+
+static int
+universeToVme(void *id, epicsUInt32 vmeAddr, int adrsSpace,
+              void *pLocal, int length, int dataWidth)
+{
+    return universeDmaToVme((DMA_ID)id, vmeAddr, adrsSpace,
+                            pLocal, length, dataWidth);
+}
+
+static int
+universeFromVme(void *id, void *pLocal, epicsUInt32 vmeAddr,
+                int adrsSpace, int length, int dataWidth)
+{
+    return universeDmaFromVme((DMA_ID)id, pLocal, vmeAddr,
+                              adrsSpace, length, dataWidth);
+}
+
+/*
+ * The packets of a list belong to the DMA_ID, which frees them with its
+ * next list, so queued lists keep theirs
+ */
+static int
+universeListFromVme(void *id, const epicsDmaDesc *pdesc, int ndesc)
+{
+    UniverseDmaSegRec *pseg;
+    int status;
+    int i;
+
+    if ((pseg = malloc(ndesc * sizeof(*pseg))) == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    for (i = 0 ; i < ndesc ; i++) {
+        pseg[i].pLocal = pdesc[i].pLocal;
+        pseg[i].vmeAddr = pdesc[i].vmeAddr;
+        pseg[i].adrsSpace = pdesc[i].adrsSpace;
+        pseg[i].dataWidth = pdesc[i].dataWidth;
+        pseg[i].len = pdesc[i].length;
+    }
+    status = universeDmaListStartV((DMA_ID)id, pseg, ndesc, 0);
+    free(pseg);
+    return status;
+}
+
+static int
+universeCancel(void *id)
+{
+    return universeDmaCancel((DMA_ID)id);
+}
+
+/*
+ * The Universe II does D64 (MBLT) but not 2eSST
+ */
+static int
+universeModes(void)
+{
+    return epicsDmaModeMask(epicsDmaBLT32) | epicsDmaModeMask(epicsDmaMBLT64);
+}
+
+static const epicsDmaBackend universeBackend = {
+    "universe",
+    universeCreate,
+    universeStatus,
+    universeToVme,
+    universeFromVme,
+    universeModes,
+    universeListFromVme,
+    NULL,
+    1,
+    universeCancel
+};
+#endif
+
+/*
+ * Seconds, for the wait statistics. Only called from task context.
+ * timeBase is set when the first channel is created.
+ */
+#if ((EPICS_VERSION > 3) || (EPICS_REVISION >= 14))
+static epicsTimeStamp timeBase;
+#endif
+
+static double
+now(void)
+{
+#if ((EPICS_VERSION > 3) || (EPICS_REVISION >= 14))
+    epicsTimeStamp current;
+
+    epicsTimeGetCurrent(&current);
+    return epicsTimeDiffInSeconds(&current, &timeBase);
 #else
-#include <drvUniverseDma.h>
-static DMA_ID (*psysDmaCreate)(VOIDFUNCPTR callback, void *context) = universeDmaCreate;
-static int (*psysDmaStatus)(DMA_ID dmaId) = universeDmaStatus;
-static int (*psysDmaToVme)(DMA_ID dmaId, UINT32 vmeAddr, int adrsSpace,
-              void *pLocal, int length, int dataWidth) = universeDmaToVme;
-static int (*psysDmaFromVme)(DMA_ID dmaId, void *pLocal, UINT32 vmeAddr,
-              int adrsSpace, int length, int dataWidth) = universeDmaFromVme;
+    return (double)tickGet() / sysClkRateGet();
 #endif
+}
+
+/*
+ * Seconds epicsDmaWait waits for ids created from now on, 0 for ever
+ */
+static double defaultTimeout = 1.0;
+
 /*
  * EPICS DMA identifier
+ * Each holds at most one request, which is either active or queued.
+ * A request that epicsDmaWait gave up on stays busy until the backend
+ * ends it.
  */
 struct epicsDmaInfo {
-    DMA_ID              dmaId;
+    struct epicsDmaInfo *next;      /* in the request queue */
+    struct dmaChannel   *pchannel;
+    void                *id;        /* of the backend */
     epicsDmaCallback_t  callback;
     void                *context;
     epicsEventId        eventId;
     int                 waiting;
+    int                 busy;       /* the request is active or queued */
+    int                 timedOut;   /* the waiter gave up on it */
+    double              timeout;
+    int                 toVme;
+    epicsDmaDesc        single;     /* a request that is not a list */
+    const epicsDmaDesc  *pdesc;     /* next transfer to start */
+    int                 ndesc;      /* transfers not yet started */
+    int                 status;     /* of the last finished request */
+    double              submitted;
+    unsigned long       nrequest;
+    unsigned long       nqueued;    /* requests that had to wait in the queue */
+    unsigned long       nwait;
+    double              waitTotal;
+    double              waitMax;
+    unsigned long       ntimeout;
 };
 
+/*
+ * Every registered backend has one DMA channel, which all requests of the
+ * ids created on it share. A request is started by the caller when the
+ * channel is idle. Requests that arrive while it is busy are queued, and
+ * when the active one ends the completion callback makes the next one
+ * active and wakes the thread of the channel, which starts it. The
+ * callback may run at interrupt level, where a backend can not be started.
+ * The queues are protected by epicsInterruptLock. The abort of a transfer
+ * that timed out is called without it, since backends may block there, and
+ * nothing is started on the channel until it has returned.
+ * A backend that queues itself gets every request at once, each id has its
+ * own backend id, and the backend starts the next request from its
+ * interrupt. The channel then only counts the requests.
+ */
+#define MAXBACKENDS 8
+
+typedef struct dmaChannel {
+    const epicsDmaBackend *pbackend;
+    void                *id;        /* NULL until the first epicsDmaCreate */
+    struct epicsDmaInfo *pactive;
+    struct epicsDmaInfo *phead;
+    struct epicsDmaInfo *ptail;
+    int                 depth;
+    int                 maxDepth;
+    int                 nids;
+    epicsEventId        wakeup;     /* of the channel thread */
+    int                 pending;    /* it must start the next transfer */
+    int                 aborting;   /* the active transfer is being aborted */
+    int                 nbusy;      /* requests given to a backend that queues */
+    struct epicsDmaInfo *phung;     /* of those, one that timed out */
+    unsigned long       nrequest;
+    unsigned long       nqueued;
+    unsigned long       ntimeout;
+} dmaChannel;
+
+static dmaChannel channels[MAXBACKENDS];
+static int nchannels;
+static dmaChannel *pselected;       /* for epicsDmaCreate, NULL the first */
+
+static void myCallback(void *context);
+
+/*
+ * Start the next transfer of the active request
+ */
+static int
+startNextDesc(struct epicsDmaInfo *dmaId)
+{
+    dmaChannel *pchannel = dmaId->pchannel;
+    const epicsDmaDesc *pdesc = dmaId->pdesc++;
+
+    dmaId->ndesc--;
+    if (dmaId->toVme)
+        return (*pchannel->pbackend->toVme)(dmaId->id, pdesc->vmeAddr,
+                                            pdesc->adrsSpace, pdesc->pLocal,
+                                            pdesc->length, pdesc->dataWidth);
+    return (*pchannel->pbackend->fromVme)(dmaId->id, pdesc->pLocal,
+                                          pdesc->vmeAddr, pdesc->adrsSpace,
+                                          pdesc->length, pdesc->dataWidth);
+}
+
+/*
+ * Start the request that has just become active.
+ * A list the backend can not chain is run one transfer at a time.
+ */
+static int
+startRequest(struct epicsDmaInfo *dmaId)
+{
+    dmaChannel *pchannel = dmaId->pchannel;
+
+    if (!dmaId->toVme && dmaId->ndesc > 1
+     && pchannel->pbackend->listFromVme != NULL) {
+        int ndesc = dmaId->ndesc;
+
+        /* The list may end before listFromVme returns */
+        dmaId->ndesc = 0;
+        if ((*pchannel->pbackend->listFromVme)(dmaId->id, dmaId->pdesc,
+                                               ndesc) == 0)
+            return 0;
+        dmaId->ndesc = ndesc;
+    }
+    return startNextDesc(dmaId);
+}
+
+/*
+ * Tell the owner of a finished request
+ */
+static void
+complete(struct epicsDmaInfo *dmaId)
+{
+    int key;
+    int waiting;
+
+    key = epicsInterruptLock();
+    waiting = dmaId->waiting;
+    dmaId->waiting = 0;
+    dmaId->busy = 0;
+    epicsInterruptUnlock(key);
+    if (waiting)
+        epicsEventSignal(dmaId->eventId);
+    if (dmaId->callback)
+        (*dmaId->callback)(dmaId->context);
+}
+
+/*
+ * Make the first queued request active, to be started by the channel
+ * thread. Called when the active request has ended, possibly at interrupt
+ * level, so nothing is started here.
+ */
+static void
+activateQueued(dmaChannel *pchannel)
+{
+    struct epicsDmaInfo *dmaId;
+    int key;
+
+    key = epicsInterruptLock();
+    dmaId = pchannel->phead;
+    if (dmaId != NULL) {
+        pchannel->phead = dmaId->next;
+        if (pchannel->phead == NULL)
+            pchannel->ptail = NULL;
+        pchannel->depth--;
+        pchannel->pending = 1;
+    }
+    pchannel->pactive = dmaId;
+    epicsInterruptUnlock(key);
+    if (dmaId != NULL)
+        epicsEventSignal(pchannel->wakeup);
+}
+
 /*
  * DMA completion callback
+ * It never starts a transfer, since for some backends it runs in the
+ * interrupt handler, which still owns the engine. The next transfer of a
+ * list that the BSP can not chain and the next queued request are left to
+ * the channel thread.
  */
 static void
 myCallback(void *context)
+{
+    dmaChannel *pchannel = (dmaChannel *)context;
+    struct epicsDmaInfo *dmaId = pchannel->pactive;
+    int status;
+
+    if (dmaId == NULL)
+        return;
+    status = (*pchannel->pbackend->status)(pchannel->id);
+    if (dmaId->timedOut)
+        status = -1;
+    if (status == 0 && dmaId->ndesc > 0) {
+        pchannel->pending = 1;
+        epicsEventSignal(pchannel->wakeup);
+        return;
+    }
+    dmaId->ndesc = 0;
+    dmaId->status = status;
+    activateQueued(pchannel);
+    complete(dmaId);
+}
+
+/*
+ * Completion callback of a backend that queues, with the id as context.
+ * Such a backend may be started here, so the next transfer of a list it
+ * could not chain is started at once, behind the requests already queued.
+ */
+static void
+queueCallback(void *context)
 {
     struct epicsDmaInfo *dmaId = (struct epicsDmaInfo *)context;
+    dmaChannel *pchannel = dmaId->pchannel;
+    int status;
+    int key;
 
-    if (dmaId->waiting) {
-        dmaId->waiting = 0;
-        epicsEventSignal(dmaId->eventId);
+    status = (*pchannel->pbackend->status)(dmaId->id);
+    if (dmaId->timedOut)
+        status = -1;
+    if (status == 0 && dmaId->ndesc > 0) {
+        if (startNextDesc(dmaId) == 0)
+            return;
+        status = -1;
     }
-    if (dmaId->callback)
-        (*dmaId->callback)(dmaId->context);
+    dmaId->ndesc = 0;
+    dmaId->status = status;
+    key = epicsInterruptLock();
+    pchannel->nbusy--;
+    if (pchannel->phung == dmaId)
+        pchannel->phung = NULL;
+    epicsInterruptUnlock(key);
+    complete(dmaId);
+}
+
+/*
+ * Start the active request, or its next transfer, in task context
+ */
+static void
+dmaThread(void *arg)
+{
+    dmaChannel *pchannel = (dmaChannel *)arg;
+    struct epicsDmaInfo *dmaId;
+    int key;
+
+    for (;;) {
+        epicsEventWait(pchannel->wakeup);
+        for (;;) {
+            key = epicsInterruptLock();
+            dmaId = NULL;
+            if (pchannel->pending && !pchannel->aborting) {
+                dmaId = pchannel->pactive;
+                pchannel->pending = 0;
+            }
+            epicsInterruptUnlock(key);
+            if (dmaId == NULL)
+                break;
+            if (!dmaId->timedOut && (startRequest(dmaId) == 0))
+                break;
+            dmaId->ndesc = 0;
+            dmaId->status = -1;
+            activateQueued(pchannel);
+            complete(dmaId);
+        }
+    }
+}
+
+/*
+ * Create the wakeup event and thread of a channel
+ */
+static int
+startThread(dmaChannel *pchannel)
+{
+    if ((pchannel->wakeup = epicsEventCreate(epicsEventEmpty)) == NULL)
+        return -1;
+#if ((EPICS_VERSION > 3) || (EPICS_REVISION >= 14))
+    {
+        char name[32];
+
+        sprintf(name, "dma %.24s", pchannel->pbackend->name);
+        if (epicsThreadCreate(name, epicsThreadPriorityHigh,
+                              epicsThreadGetStackSize(epicsThreadStackSmall),
+                              dmaThread, pchannel) == NULL) {
+            pchannel->wakeup = NULL;
+            return -1;
+        }
+    }
+#else
+    if (taskSpawn("tDma", 50, VX_FP_TASK, 4000, (FUNCPTR)dmaThread,
+                  (int)pchannel, 0, 0, 0, 0, 0, 0, 0, 0, 0) == ERROR) {
+        pchannel->wakeup = NULL;
+        return -1;
+    }
+#endif
+    return 0;
 }
 
 /*
- * Create a DMA handler
+ * Queue a request, or start it if the channel is idle
+ */
+static int
+submit(struct epicsDmaInfo *dmaId, const epicsDmaDesc *pdesc, int ndesc,
+       int toVme)
+{
+    dmaChannel *pchannel = dmaId->pchannel;
+    int key;
+    int status;
+
+    if (dmaId->busy) {
+        errno = EBUSY;
+        return -1;
+    }
+    dmaId->next = NULL;
+    dmaId->pdesc = pdesc;
+    dmaId->ndesc = ndesc;
+    dmaId->toVme = toVme;
+    dmaId->status = 0;
+    dmaId->timedOut = 0;
+    dmaId->submitted = now();
+    key = epicsInterruptLock();
+    /* Behind a transfer that timed out the request could only time out */
+    if (((pchannel->pactive != NULL) && pchannel->pactive->timedOut)
+     || (pchannel->phung != NULL)) {
+        epicsInterruptUnlock(key);
+        errno = EBUSY;
+        return -1;
+    }
+    dmaId->busy = 1;
+    dmaId->nrequest++;
+    pchannel->nrequest++;
+    if (pchannel->pbackend->queues) {
+        if (pchannel->nbusy++ > 0) {
+            pchannel->nqueued++;
+            dmaId->nqueued++;
+            if (pchannel->nbusy - 1 > pchannel->maxDepth)
+                pchannel->maxDepth = pchannel->nbusy - 1;
+        }
+        epicsInterruptUnlock(key);
+        status = startRequest(dmaId);
+        if (status != 0) {
+            key = epicsInterruptLock();
+            dmaId->ndesc = 0;
+            dmaId->busy = 0;
+            pchannel->nbusy--;
+            epicsInterruptUnlock(key);
+        }
+        return status;
+    }
+    if ((pchannel->pactive != NULL) || pchannel->aborting) {
+        if (pchannel->ptail != NULL)
+            pchannel->ptail->next = dmaId;
+        else
+            pchannel->phead = dmaId;
+        pchannel->ptail = dmaId;
+        if (++pchannel->depth > pchannel->maxDepth)
+            pchannel->maxDepth = pchannel->depth;
+        pchannel->nqueued++;
+        dmaId->nqueued++;
+        epicsInterruptUnlock(key);
+        return 0;
+    }
+    pchannel->pactive = dmaId;
+    epicsInterruptUnlock(key);
+    status = startRequest(dmaId);
+    if (status != 0) {
+        dmaId->ndesc = 0;
+        dmaId->busy = 0;
+        activateQueued(pchannel);
+    }
+    return status;
+}
+
+/*
+ * Add the backends of this build to the registry, the BSP first
+ */
+static void
+registerBuiltin(void)
+{
+    static int done;
+    const epicsDmaBackend *pbackend;
+
+    if (done)
+        return;
+    done = 1;
+    if ((pbackend = bspBackendGet()) != NULL)
+        epicsDmaRegister(pbackend);
+#ifdef HAS_UNIVERSEDMA
+    epicsDmaRegister(&universeBackend);
+#endif
+}
+
+static dmaChannel *
+findChannel(const char *name)
+{
+    int i;
+
+    for (i = 0 ; i < nchannels ; i++) {
+        if (strcmp(channels[i].pbackend->name, name) == 0)
+            return &channels[i];
+    }
+    return NULL;
+}
+
+/*
+ * Register a backend. Registering it again does nothing.
+ */
+int
+epicsDmaRegister(const epicsDmaBackend *pbackend)
+{
+    dmaChannel *pchannel;
+
+    registerBuiltin();
+    pchannel = findChannel(pbackend->name);
+    if (pchannel != NULL) {
+        if (pchannel->pbackend == pbackend)
+            return 0;
+        errno = EEXIST;
+        return -1;
+    }
+    if (nchannels >= MAXBACKENDS) {
+        errno = ENOSPC;
+        return -1;
+    }
+    channels[nchannels++].pbackend = pbackend;
+    return 0;
+}
+
+/*
+ * Select the backend for the following epicsDmaCreate calls
+ */
+int
+epicsDmaSelect(const char *name)
+{
+    dmaChannel *pchannel;
+
+    registerBuiltin();
+    if ((name == NULL) || (name[0] == '\0')) {
+        pselected = NULL;
+        return 0;
+    }
+    if ((pchannel = findChannel(name)) == NULL) {
+        errno = ENOENT;
+        return -1;
+    }
+    pselected = pchannel;
+    return 0;
+}
+
+/*
+ * Create a DMA handler on the selected backend
  */
 epicsDmaId
 epicsDmaCreate(epicsDmaCallback_t callback, void *context)
 {
     struct epicsDmaInfo *dmaId;
+    dmaChannel *pchannel;
 
-    if ((psysDmaCreate == NULL)
-     || (psysDmaStatus == NULL)
-     || (psysDmaToVme == NULL)
-     || (psysDmaFromVme == NULL))
+    registerBuiltin();
+    pchannel = pselected;
+    if ((pchannel == NULL) && (nchannels > 0))
+        pchannel = &channels[0];
+    if (pchannel == NULL)
         return NULL;
-    if ((dmaId = malloc(sizeof(*dmaId))) == NULL)
+    if (pchannel->id == NULL) {
+#if ((EPICS_VERSION > 3) || (EPICS_REVISION >= 14))
+        int i;
+
+        for (i = 0 ; (i < nchannels) && (channels[i].id == NULL) ; i++)
+            ;
+        if (i >= nchannels)
+            epicsTimeGetCurrent(&timeBase);
+#endif
+        if (pchannel->pbackend->queues) {
+            pchannel->id = pchannel;    /* in use */
+        } else {
+            if ((pchannel->wakeup == NULL) && (startThread(pchannel) != 0))
+                return NULL;
+            pchannel->id = (*pchannel->pbackend->create)(myCallback, pchannel);
+            if (pchannel->id == NULL)
+                return NULL;
+        }
+    }
+    if ((dmaId = calloc(1, sizeof(*dmaId))) == NULL)
         return NULL;
-    if ((dmaId->dmaId = (*psysDmaCreate)(myCallback, dmaId)) == NULL) {
+    if (!pchannel->pbackend->queues) {
+        dmaId->id = pchannel->id;
+    } else if ((dmaId->id = (*pchannel->pbackend->create)(queueCallback,
+                                                          dmaId)) == NULL) {
         free(dmaId);
         return NULL;
     }
-    dmaId->eventId = NULL;
+    dmaId->pchannel = pchannel;
     dmaId->callback = callback;
     dmaId->context = context;
+    dmaId->timeout = defaultTimeout;
+    pchannel->nids++;
     return dmaId;
 }
 
 /*
- * Return DMA handler status
+ * Return the status of the last finished transaction
  */
 int
 epicsDmaStatus(epicsDmaId dmaId)
 {
-    return (*psysDmaStatus)(dmaId->dmaId);
+    return dmaId->status;
+}
+
+/*
+ * Return the block transfer modes of the bridge
+ */
+int
+epicsDmaModes(epicsDmaId dmaId)
+{
+    const epicsDmaBackend *pbackend = dmaId->pchannel->pbackend;
+
+    if (pbackend->modes != NULL)
+        return (*pbackend->modes)() | epicsDmaModeMask(epicsDmaBLT32);
+    return epicsDmaModeMask(epicsDmaBLT32);
+}
+
+/*
+ * Return the widest supported mode not wider than mode
+ */
+int
+epicsDmaBestMode(epicsDmaId dmaId, int mode)
+{
+    int modes = epicsDmaModes(dmaId);
+
+    for ( ; mode >= epicsDmaBLT32 ; mode--) {
+        if (modes & epicsDmaModeMask(mode))
+            return mode;
+    }
+    return 0;
 }
 
 /*
@@ -121,7 +812,12 @@ int
 epicsDmaToVme(epicsDmaId dmaId, epicsUInt32 vmeAddr, int adrsSpace,
                           void *pLocal, int length, int dataWidth)
 {
-    return (*psysDmaToVme)(dmaId->dmaId, vmeAddr, adrsSpace, pLocal, length, dataWidth);
+    dmaId->single.pLocal = pLocal;
+    dmaId->single.vmeAddr = vmeAddr;
+    dmaId->single.adrsSpace = adrsSpace;
+    dmaId->single.length = length;
+    dmaId->single.dataWidth = dataWidth;
+    return submit(dmaId, &dmaId->single, 1, 1);
 }
 
 /*
@@ -131,7 +827,28 @@ int
 epicsDmaFromVme(epicsDmaId dmaId, void *pLocal, epicsUInt32 vmeAddr,
                           int adrsSpace, int length, int dataWidth)
 {
-    return (*psysDmaFromVme)(dmaId->dmaId, pLocal, vmeAddr, adrsSpace, length, dataWidth);
+    dmaId->single.pLocal = pLocal;
+    dmaId->single.vmeAddr = vmeAddr;
+    dmaId->single.adrsSpace = adrsSpace;
+    dmaId->single.length = length;
+    dmaId->single.dataWidth = dataWidth;
+    return submit(dmaId, &dmaId->single, 1, 0);
+}
+
+/*
+ * Prepare for epicsDmaWait
+ */
+static int
+prepareWait(epicsDmaId dmaId)
+{
+    if (dmaId->eventId == NULL) {
+        if ((dmaId->eventId = epicsEventCreate(epicsEventEmpty)) == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    dmaId->waiting = 1;
+    return 0;
 }
 
 /*
@@ -143,18 +860,176 @@ epicsDmaToVmeAndWait(epicsDmaId dmaId, epicsUInt32 vmeAddr, int adrsSpace,
 {
     int status;
 
-    if (dmaId->eventId == NULL) {
-        if ((dmaId->eventId = epicsEventCreate(epicsEventEmpty)) == NULL) {
-            errno = ENOMEM;
+    if (prepareWait(dmaId) != 0)
+        return -1;
+    status = epicsDmaToVme(dmaId, vmeAddr, adrsSpace, pLocal, length, dataWidth);
+    if (status != 0) {
+        dmaId->waiting = 0;
+        return status;
+    }
+    return epicsDmaWait(dmaId);
+}
+
+/*
+ * Start a DMA transaction from a VME module that is waited for with epicsDmaWait
+ */
+int
+epicsDmaFromVmeStart(epicsDmaId dmaId, void *pLocal, epicsUInt32 vmeAddr,
+                                 int adrsSpace, int length, int dataWidth)
+{
+    int status;
+
+    if (prepareWait(dmaId) != 0)
+        return -1;
+    status = epicsDmaFromVme(dmaId, pLocal, vmeAddr, adrsSpace, length, dataWidth);
+    if (status != 0)
+        dmaId->waiting = 0;
+    return status;
+}
+
+/*
+ * Give up on the request of dmaId. A queued request is taken out of the
+ * queue, an active one is aborted if the backend can and otherwise left
+ * to end on its own. Returns -1 if it ended anyway.
+ */
+static int
+abandon(epicsDmaId dmaId)
+{
+    dmaChannel *pchannel = dmaId->pchannel;
+    struct epicsDmaInfo **pprev;
+    struct epicsDmaInfo *plast = NULL;
+    int key;
+    int pending;
+
+    key = epicsInterruptLock();
+    if (!dmaId->waiting) {
+        epicsInterruptUnlock(key);
+        return -1;
+    }
+    dmaId->waiting = 0;
+    dmaId->timedOut = 1;
+    dmaId->ntimeout++;
+    pchannel->ntimeout++;
+    if (pchannel->pbackend->queues) {
+        epicsInterruptUnlock(key);
+        if ((pchannel->pbackend->cancel != NULL)
+         && ((*pchannel->pbackend->cancel)(dmaId->id) == 0)) {
+            key = epicsInterruptLock();
+            dmaId->ndesc = 0;
+            dmaId->busy = 0;
+            pchannel->nbusy--;
+            epicsInterruptUnlock(key);
+            return 0;
+        }
+        /* Started. Others are refused until it has ended */
+        key = epicsInterruptLock();
+        if (dmaId->busy)
+            pchannel->phung = dmaId;
+        epicsInterruptUnlock(key);
+        return 0;
+    }
+    for (pprev = &pchannel->phead ; *pprev != NULL ; pprev = &(*pprev)->next) {
+        if (*pprev == dmaId) {
+            *pprev = dmaId->next;
+            if (pchannel->ptail == dmaId)
+                pchannel->ptail = plast;
+            pchannel->depth--;
+            dmaId->busy = 0;
+            epicsInterruptUnlock(key);
+            return 0;
+        }
+        plast = *pprev;
+    }
+    if ((pchannel->pactive != dmaId) || (pchannel->pbackend->abort == NULL)) {
+        epicsInterruptUnlock(key);
+        return 0;
+    }
+    pchannel->aborting = 1;
+    epicsInterruptUnlock(key);
+    (*pchannel->pbackend->abort)(pchannel->id);
+    /* Start what was held back while the abort ran */
+    key = epicsInterruptLock();
+    pchannel->aborting = 0;
+    if ((pchannel->pactive == NULL) && (pchannel->phead != NULL)) {
+        pchannel->pactive = pchannel->phead;
+        pchannel->phead = pchannel->pactive->next;
+        if (pchannel->phead == NULL)
+            pchannel->ptail = NULL;
+        pchannel->depth--;
+        pchannel->pending = 1;
+    }
+    pending = pchannel->pending;
+    epicsInterruptUnlock(key);
+    if (pending)
+        epicsEventSignal(pchannel->wakeup);
+    return 0;
+}
+
+/*
+ * Wait for the transaction started by epicsDmaFromVmeStart
+ */
+int
+epicsDmaWait(epicsDmaId dmaId)
+{
+    double wait;
+
+    if (dmaId->timeout <= 0.0) {
+        epicsEventWait(dmaId->eventId);
+    }
+    else if (epicsEventWaitWithTimeout(dmaId->eventId, dmaId->timeout)
+                                                    != epicsEventWaitOK) {
+        if (abandon(dmaId) == 0) {
+            errno = ETIMEDOUT;
             return -1;
         }
+        /* It ended while we gave up. The event is or will be signalled */
+        epicsEventWait(dmaId->eventId);
     }
-    dmaId->waiting = 1;
-    status = epicsDmaToVme(dmaId, vmeAddr, adrsSpace, pLocal, length, dataWidth);
+    wait = now() - dmaId->submitted;
+    dmaId->nwait++;
+    dmaId->waitTotal += wait;
+    if (wait > dmaId->waitMax)
+        dmaId->waitMax = wait;
+    return dmaId->status;
+}
+
+/*
+ * Set how long epicsDmaWait waits
+ */
+void
+epicsDmaSetTimeout(epicsDmaId dmaId, double seconds)
+{
+    dmaId->timeout = seconds;
+}
+
+/*
+ * Set the timeout of the ids created from now on
+ */
+void
+epicsDmaSetDefaultTimeout(double seconds)
+{
+    defaultTimeout = seconds;
+}
+
+/*
+ * Start a chained list of transactions from VME modules
+ */
+int
+epicsDmaListFromVmeStart(epicsDmaId dmaId, const epicsDmaDesc *pdesc,
+                                     int ndesc)
+{
+    int status;
+
+    if (ndesc <= 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (prepareWait(dmaId) != 0)
+        return -1;
+    status = submit(dmaId, pdesc, ndesc, 0);
     if (status != 0)
-        return status;
-    epicsEventWait(dmaId->eventId);
-    return epicsDmaStatus(dmaId);
+        dmaId->waiting = 0;
+    return status;
 }
 
 /*
@@ -166,16 +1041,138 @@ epicsDmaFromVmeAndWait(epicsDmaId dmaId, void *pLocal, epicsUInt32 vmeAddr,
 {
     int status;
 
-    if (dmaId->eventId == NULL) {
-        if ((dmaId->eventId = epicsEventCreate(epicsEventEmpty)) == NULL) {
-            errno = ENOMEM;
-            return -1;
-        }
-    }
-    dmaId->waiting = 1;
-    status = epicsDmaFromVme(dmaId, pLocal, vmeAddr, adrsSpace, length, dataWidth);
+    status = epicsDmaFromVmeStart(dmaId, pLocal, vmeAddr, adrsSpace, length, dataWidth);
     if (status != 0)
         return status;
-    epicsEventWait(dmaId->eventId);
-    return epicsDmaStatus(dmaId);
+    return epicsDmaWait(dmaId);
 }
+
+/*
+ * Run the transactions of pdesc back to back and wait for all of them
+ */
+int
+epicsDmaFromVmeV(epicsDmaId dmaId, const epicsDmaDesc *pdesc, int ndesc)
+{
+    int status;
+
+    status = epicsDmaListFromVmeStart(dmaId, pdesc, ndesc);
+    if (status != 0)
+        return status;
+    return epicsDmaWait(dmaId);
+}
+
+/*
+ * Report the requests of dmaId and, for level > 1, the shared queue
+ */
+void
+epicsDmaReport(epicsDmaId dmaId, int level)
+{
+    dmaChannel *pchannel = dmaId->pchannel;
+
+    printf("    dma %s requests %lu queued %lu wait mean %.1f max %.1f usec\n",
+           pchannel->pbackend->name, dmaId->nrequest, dmaId->nqueued,
+           dmaId->nwait ? 1e6 * dmaId->waitTotal / dmaId->nwait : 0.0,
+           1e6 * dmaId->waitMax);
+    if (dmaId->ntimeout)
+        printf("    dma timeouts %lu after %.3f sec%s\n", dmaId->ntimeout,
+               dmaId->timeout, dmaId->busy ? ", last transfer not ended" : "");
+    if (level > 1)
+        printf("    dma channel requests %lu queued %lu depth %d max %d"
+               " timeouts %lu\n",
+               pchannel->nrequest, pchannel->nqueued,
+               pchannel->pbackend->queues
+                   ? (pchannel->nbusy > 0 ? pchannel->nbusy - 1 : 0)
+                   : pchannel->depth,
+               pchannel->maxDepth, pchannel->ntimeout);
+}
+
+/*
+ * List the registered backends
+ */
+void
+epicsDmaBackendReport(int level)
+{
+    int i;
+
+    registerBuiltin();
+    for (i = 0 ; i < nchannels ; i++) {
+        dmaChannel *pchannel = &channels[i];
+        int isDefault = (pselected == NULL) ? (i == 0) : (pchannel == pselected);
+
+        printf("%-12s %s ids %d requests %lu queued %lu max depth %d\n",
+               pchannel->pbackend->name, isDefault ? "selected" : "        ",
+               pchannel->nids, pchannel->nrequest, pchannel->nqueued,
+               pchannel->maxDepth);
+        if (level > 0) {
+            const epicsDmaBackend *pbackend = pchannel->pbackend;
+            int modes = epicsDmaModeMask(epicsDmaBLT32);
+
+            if (pbackend->modes != NULL)
+                modes |= (*pbackend->modes)();
+            printf("    modes%s%s%s chained lists %s\n",
+                   (modes & epicsDmaModeMask(epicsDmaBLT32)) ? " BLT32" : "",
+                   (modes & epicsDmaModeMask(epicsDmaMBLT64)) ? " MBLT64" : "",
+                   (modes & epicsDmaModeMask(epicsDma2eSST)) ? " 2eSST" : "",
+                   pbackend->listFromVme ? "yes" : "no");
+        }
+    }
+}
+
+#if ((EPICS_VERSION > 3) || (EPICS_REVISION >= 14))
+/*
+ * IOC shell command registration
+ */
+#include <iocsh.h>
+#include <epicsExport.h>
+static const iocshArg epicsDmaSelectArg0 = { "backend",iocshArgString};
+static const iocshArg *epicsDmaSelectArgs[] = {&epicsDmaSelectArg0};
+static const iocshFuncDef epicsDmaSelectFuncDef =
+                      {"epicsDmaSelect",1,epicsDmaSelectArgs};
+static void epicsDmaSelectCallFunc(const iocshArgBuf *args)
+{
+    if (epicsDmaSelect(args[0].sval) != 0) {
+        printf("epicsDmaSelect: no backend \"%s\"\n", args[0].sval);
+        epicsDmaBackendReport(0);
+    }
+}
+
+static const iocshArg epicsDmaBackendReportArg0 = { "level",iocshArgInt};
+static const iocshArg *epicsDmaBackendReportArgs[] = {
+    &epicsDmaBackendReportArg0};
+static const iocshFuncDef epicsDmaBackendReportFuncDef =
+                      {"epicsDmaBackendReport",1,epicsDmaBackendReportArgs};
+static void epicsDmaBackendReportCallFunc(const iocshArgBuf *args)
+{
+    epicsDmaBackendReport(args[0].ival);
+}
+
+static const iocshArg epicsDmaSetDefaultTimeoutArg0 = { "seconds",iocshArgDouble};
+static const iocshArg *epicsDmaSetDefaultTimeoutArgs[] = {
+    &epicsDmaSetDefaultTimeoutArg0};
+static const iocshFuncDef epicsDmaSetDefaultTimeoutFuncDef =
+                      {"epicsDmaSetDefaultTimeout",1,
+                       epicsDmaSetDefaultTimeoutArgs};
+static void epicsDmaSetDefaultTimeoutCallFunc(const iocshArgBuf *args)
+{
+    epicsDmaSetDefaultTimeout(args[0].dval);
+}
+
+/*
+ * This routine is called before multitasking has started, so there's
+ * no race condition in the test/set of firstTime.
+ */
+static void
+epicsDmaRegisterCommands(void)
+{
+    static int firstTime = 1;
+    if (firstTime) {
+        iocshRegister(&epicsDmaSelectFuncDef,epicsDmaSelectCallFunc);
+        iocshRegister(&epicsDmaBackendReportFuncDef,
+                      epicsDmaBackendReportCallFunc);
+        iocshRegister(&epicsDmaSetDefaultTimeoutFuncDef,
+                      epicsDmaSetDefaultTimeoutCallFunc);
+        firstTime = 0;
+    }
+}
+epicsExportRegistrar(epicsDmaRegisterCommands);
+#endif
@@ -6,11 +6,91 @@
 typedef void (*epicsDmaCallback_t)(void *);
 typedef struct epicsDmaInfo *epicsDmaId;
 
+/*
+ * Block transfer modes, narrowest first
+ */
+#define epicsDmaBLT32   1
+#define epicsDmaMBLT64  2
+#define epicsDma2eSST   3
+#define epicsDmaModeMask(mode) (1 << (mode))
+
+/*
+ * A32 address modifiers for the 64 bit modes.
+ * These are passed with a dataWidth of 8.
+ */
+#define epicsDmaAmA32Mblt   0x0c
+#define epicsDmaAmA32_2eSST 0x20
+
+/*
+ * One transfer of a chained list
+ */
+typedef struct epicsDmaDesc {
+    void        *pLocal;
+    epicsUInt32 vmeAddr;
+    int         adrsSpace;
+    int         length;
+    int         dataWidth;
+} epicsDmaDesc;
+
+/*
+ * A DMA engine. create is called once, by the first epicsDmaCreate on the
+ * backend, and returns the id passed to the other routines, which return 0
+ * when the transfer was started. callback is called, possibly at interrupt
+ * level, with context when a transfer or list has ended.
+ * modes returns the epicsDmaModeMask of the modes supported.
+ * abort stops the transfer in progress, which then ends with an error and
+ * the callback as usual.
+ * modes, listFromVme and abort may be NULL.
+ * A backend with queues set keeps its own queue and starts the next
+ * request from its interrupt. create is then called by every
+ * epicsDmaCreate, the start routines may be called from the callback,
+ * and cancel takes a request that has not started out of the queue,
+ * returning 0 if it did. Otherwise cancel is NULL and epicsDma queues.
+ */
+typedef struct epicsDmaBackend {
+    const char *name;
+    void *(*create)(epicsDmaCallback_t callback, void *context);
+    int (*status)(void *id);
+    int (*toVme)(void *id, epicsUInt32 vmeAddr, int adrsSpace,
+                 void *pLocal, int length, int dataWidth);
+    int (*fromVme)(void *id, void *pLocal, epicsUInt32 vmeAddr,
+                   int adrsSpace, int length, int dataWidth);
+    int (*modes)(void);
+    int (*listFromVme)(void *id, const epicsDmaDesc *pdesc, int ndesc);
+    int (*abort)(void *id);
+    int queues;
+    int (*cancel)(void *id);
+} epicsDmaBackend;
+
 /*
  * EPICS wrappers/additions
  */
+/*
+ * Backends are registered by name. The BSP sysDma routines, if the BSP has
+ * them, are registered as "sysDma" and with HAS_UNIVERSEDMA the Universe
+ * driver as "universe". epicsDmaCreate uses the backend last selected with
+ * epicsDmaSelect or, if none is, the first registered, so a backend can be
+ * chosen per card by selecting it before the driver Config command.
+ * A NULL or empty name selects the default again.
+ */
+int epicsDmaRegister(const epicsDmaBackend *pbackend);
+int epicsDmaSelect(const char *name);
+void epicsDmaBackendReport(int level);
+/*
+ * All epicsDmaIds of a backend share its DMA channel. Each holds one
+ * request at a time, which waits in a queue while the channel is busy.
+ */
 epicsDmaId epicsDmaCreate(epicsDmaCallback_t callback, void *context);
 int epicsDmaStatus(epicsDmaId dmaId);
+/*
+ * Returns epicsDmaModeMask(mode) for every mode the bridge supports
+ */
+int epicsDmaModes(epicsDmaId dmaId);
+/*
+ * Returns the widest mode, not wider than mode, that the bridge supports
+ * or 0 if there is none
+ */
+int epicsDmaBestMode(epicsDmaId dmaId, int mode);
 int epicsDmaToVme(epicsDmaId dmaId, epicsUInt32 vmeAddr, int adrsSpace,
                           void *pLocal, int length, int dataWidth);
 int epicsDmaFromVme(epicsDmaId dmaId, void *pLocal, epicsUInt32 vmeAddr,
@@ -19,5 +99,40 @@ int epicsDmaToVmeAndWait(epicsDmaId dmaId, epicsUInt32 vmeAddr, int adrsSpace,
                                  void *pLocal, int length, int dataWidth);
 int epicsDmaFromVmeAndWait(epicsDmaId dmaId, void *pLocal, epicsUInt32 vmeAddr,
                                    int adrsSpace, int length, int dataWidth);
+/*
+ * Split form of epicsDmaFromVmeAndWait, so that the caller can work
+ * while the transfer runs. Every successful Start must be followed by Wait.
+ */
+int epicsDmaFromVmeStart(epicsDmaId dmaId, void *pLocal, epicsUInt32 vmeAddr,
+                                 int adrsSpace, int length, int dataWidth);
+int epicsDmaWait(epicsDmaId dmaId);
+/*
+ * epicsDmaWait, and so the AndWait routines, wait at most timeout seconds,
+ * 0 for ever. The default for new ids is 1 second. On timeout they return
+ * -1 with errno ETIMEDOUT and the transfer is aborted if the backend can.
+ * Until it has ended new requests of the id, and of all ids while it is
+ * the active one on the channel, fail at once with errno EBUSY, so that
+ * the callers can go on without DMA.
+ */
+void epicsDmaSetTimeout(epicsDmaId dmaId, double seconds);
+void epicsDmaSetDefaultTimeout(double seconds);
+/*
+ * Start the ndesc transfers of pdesc as one chained transfer.
+ * It is waited for with epicsDmaWait, which returns the first error.
+ * pdesc must not change until then.
+ */
+int epicsDmaListFromVmeStart(epicsDmaId dmaId, const epicsDmaDesc *pdesc,
+                                     int ndesc);
+/*
+ * Vectored epicsDmaFromVmeAndWait. The transfers of pdesc, each with its
+ * own address modifier and width, are chained where the backend can and
+ * otherwise run one after the other. Returns when all are done or after
+ * the first that failed.
+ */
+int epicsDmaFromVmeV(epicsDmaId dmaId, const epicsDmaDesc *pdesc, int ndesc);
+/*
+ * Request counts and wait times of dmaId, for level > 1 also the queue
+ */
+void epicsDmaReport(epicsDmaId dmaId, int level);
 
 #endif /* _EPICSDMA_H_ */
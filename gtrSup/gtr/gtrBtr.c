@@ -0,0 +1,1175 @@
+/*gtrBtr.c */
+
+/*************************************************************************
+* Copyright (c) 2002 The University of Chicago, as Operator of Argonne
+* National Laboratory, and the Regents of the University of California, as
+* Operator of Los Alamos National Laboratory. EPICS BASE Versions 3.13.7
+* and higher are distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*************************************************************************/
+
+/* Reads are lists of segments. They are done in batches of up to BATCHDESC
+ * transfers and CHUNKBYTES bytes, which alternate between the two halves of
+ * buffer. A batch is started as one chained transfer. The batch after it
+ * is started before the data of a batch is passed on, so that the DMA runs
+ * while the previous batch is unpacked.
+ *
+ * Segments are read from regions of board memory. The region of a plan is
+ * its whole circular buffer, that of any other segment the segment itself.
+ * The batches of the last list are built for its regions and kept, and
+ * are used again as long as the regions do not change, which for most
+ * readouts is always. In prePostTrigger the segments move within the ring
+ * with the trigger location, so each read starts only the kept batches
+ * that hold wanted bytes, and the first and last transfer of each are
+ * patched in place to begin and end near the wanted bytes. Nothing is
+ * worked out or allocated per trigger then. A list that needs more than
+ * MAXCACHEBLOCKS transfers is not kept and its batches are built one at a
+ * time from the segments while the DMA runs.
+ *
+ * For small reads the DMA setup costs more than single cycles. gtrBtrCalibrate
+ * times both for sizes up to CALIBRATEMAX and reads with fewer bytes than
+ * the smallest size from which DMA stays faster are done directly. A list
+ * counts as one read because its transfers are chained.
+ *
+ * A list of plans that is read directly, e.g. the groups of a board, is
+ * split into equal parts that are unpacked at the same time by the caller
+ * and gtrBtrWorkers - 1 worker threads. Plans write disjoint parts of the
+ * channels and are unpacked by readout word, so the parts need no order.
+ * Lists with block functions are read in order by the caller.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <epicsTypes.h>
+#include <epicsTime.h>
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsDma.h>
+
+#include "devLib.h"
+
+#include "drvGtr.h"
+#include "gtrUnpack.h"
+#include "gtrBtr.h"
+
+#define CHUNKBYTES 8192
+#define BATCHDESC 64
+#define BLOCKBOUNDARY 256
+#define MAXCACHEBLOCKS 4096
+#define CALIBRATEMIN 64
+#define CALIBRATEMAX 65536
+#define NCALIBRATE 6         /* CALIBRATEMIN, 4*CALIBRATEMIN, ... */
+#define CALIBRATESECONDS 0.05
+#define DMANEVER 0x7fffffff
+#define MAXWORKERS 16
+#define PARALLELMIN 262144   /* waking the workers costs more for less */
+
+/* 0 reads with DMA whatever the size, without calibrating */
+int gtrBtrAutoDma = 1;
+/* Threads that unpack a direct read. Taken by the first read of a list */
+int gtrBtrWorkers = 1;
+
+/* One DMA transfer and the part of it that was asked for */
+typedef struct btrBlock {
+    char        *pbuffer;
+    epicsUInt32 offset;    /* of the transfer */
+    int         nbytes;    /* of the transfer */
+    int         am;
+    int         width;
+    epicsUInt32 beg;       /* first wanted byte */
+    epicsUInt32 end;       /* after the last wanted byte */
+    int         seg;       /* the segment it belongs to */
+} btrBlock;
+
+/* A range of board memory and where its data goes. Segments added by
+ * gtrBtrListAddMasked have pdest set, those added by gtrBtrListAddPlan
+ * neither func nor pdest and are unpacked by plan.
+ */
+typedef struct btrSegment {
+    epicsUInt32     offset;
+    int             nbytes;
+    gtrBtrBlockFunc func;
+    void            *pvt;
+    epicsInt16      *pdest;
+    epicsInt16      mask;
+    int             plan;
+    int             index;   /* readout word of offset */
+} btrSegment;
+
+/* Board memory that consecutive segments are read from */
+typedef struct btrRegion {
+    epicsUInt32 offset;
+    int         nbytes;
+    int         firstSeg;
+    int         nseg;
+} btrRegion;
+
+/* Position in the segment list */
+typedef struct btrCursor {
+    int         seg;
+    epicsUInt32 pos;
+} btrCursor;
+
+typedef struct btrBatch {
+    btrCursor    start;
+    char         *pbuffer;  /* the half of buffer it uses */
+    int          first;     /* of block and desc in the cache */
+    int          nblock;
+    btrBlock     *block;
+    epicsDmaDesc *desc;
+    /* Kept batches: the blocks read this time and where reading
+     * starts in the first and stops in the last of them */
+    int          selFirst;
+    int          selLast;
+    epicsUInt32  selStart;
+    epicsUInt32  selStop;
+} btrBatch;
+
+/* Unpacks bytes [beg,end) of the list, counted over all segments */
+typedef struct btrWorker {
+    struct gtrBtr *btr;
+    epicsEventId  start;
+    int           beg;
+    int           end;
+} btrWorker;
+
+struct gtrBtr {
+    char          *name;
+    epicsUInt32   vmeBase;
+    char          *pmemory;
+    epicsDmaId    dmaId;
+    int           mode;      /* epicsDmaBLT32, ... */
+    char          *buffer;   /* 2*CHUNKBYTES */
+    btrBatch      batch[2];  /* for lists that are not kept */
+    btrBlock      *block;    /* 2*BATCHDESC */
+    epicsDmaDesc  *desc;     /* 2*BATCHDESC */
+    btrSegment    *seg;
+    int           nseg;
+    int           maxseg;
+    btrRegion     *region;
+    int           nregion;
+    int           maxregion;
+    int           listBytes; /* of all segments */
+    int           nfunc;     /* segments with a block function */
+    gtrUnpackPlan *plan;
+    int           nplan;
+    int           maxplan;
+    /* The kept batches and the regions they were built for. The blocks
+     * of kept batches have the region in seg */
+    btrRegion     *keyRegion;
+    int           nkey;      /* -1 if nothing is kept */
+    int           maxkey;
+    int           keep;      /* the list fits in the cache */
+    btrBatch      *cache;
+    int           ncache;
+    int           maxcache;
+    btrBlock      *cacheBlock;
+    epicsDmaDesc  *cacheDesc;
+    int           ncacheBlock;
+    int           maxcacheBlock;
+    unsigned long nread;
+    unsigned long nlist;
+    unsigned long ndma;
+    unsigned long nerror;
+    unsigned long nrefused;  /* EBUSY behind a transfer that timed out */
+    int           pio;       /* the rest of this read is direct */
+    int           failing;   /* reported, until a DMA works again */
+    unsigned long nbuild;    /* lists whose batches were worked out */
+    /* Reads of fewer bytes are done directly. DMANEVER if DMA never wins */
+    int           dmaMinBytes;
+    int           ncalibrate;
+    double        pioSeconds[NCALIBRATE];
+    double        dmaSeconds[NCALIBRATE];
+    unsigned long nsmall;    /* reads done directly for their size */
+    /* worker[0] is the caller. -1 until the first list read */
+    int           nworker;
+    btrWorker     *worker;
+    epicsMutexId  workLock;
+    epicsEventId  workDone;
+    int           nbusy;     /* workers that have not finished their part */
+    unsigned long nparallel;
+};
+
+static const char *modeName[] = {"direct","BLT32","MBLT64","2eSST"};
+
+gtrBtrId gtrBtrCreate(const char *name,epicsUInt32 vmeBase,
+    volatile void *pmemory,int useDma,int maxMode)
+{
+    gtrBtrId btr;
+
+    btr = calloc(1,sizeof(struct gtrBtr));
+    if(!btr) {
+        printf("gtrBtrCreate: calloc failed\n");
+        return(0);
+    }
+    btr->name = calloc(1,strlen(name)+1);
+    if(btr->name) strcpy(btr->name,name);
+    btr->vmeBase = vmeBase;
+    btr->pmemory = (char *)pmemory;
+    btr->nkey = -1;
+    btr->nworker = -1;
+    if(useDma) {
+        btr->buffer = calloc(2*CHUNKBYTES,1);
+        btr->block = calloc(2*BATCHDESC,sizeof(btrBlock));
+        btr->desc = calloc(2*BATCHDESC,sizeof(epicsDmaDesc));
+        if(!btr->buffer || !btr->block || !btr->desc) {
+            printf("gtrBtrCreate: calloc failed\n");
+        } else {
+            int ind;
+
+            for(ind=0; ind<2; ind++) {
+                btr->batch[ind].block = btr->block + ind*BATCHDESC;
+                btr->batch[ind].desc = btr->desc + ind*BATCHDESC;
+            }
+            btr->dmaId = epicsDmaCreate(NULL,NULL);
+        }
+    }
+    if(btr->dmaId) {
+        int mode = (useDma>maxMode) ? maxMode : useDma;
+
+        if(mode>epicsDma2eSST) mode = epicsDma2eSST;
+        btr->mode = epicsDmaBestMode(btr->dmaId,mode);
+        if(btr->mode<useDma)
+            printf("%s: useDma %d not supported. Using %s\n",
+                btr->name,useDma,modeName[btr->mode]);
+        if(!btr->mode) btr->dmaId = 0;
+    }
+    return(btr);
+}
+
+int gtrBtrUsesDma(gtrBtrId btr)
+{
+    return(btr->dmaId ? btr->mode : 0);
+}
+
+/* Where the transfer in mode that starts at offset must end, given that it
+ * may not go beyond stop. offset and stop are multiples of 4.
+ * Also returns the address modifier and data width to use.
+ */
+static epicsUInt32 transferEnd(int mode,epicsUInt32 offset,
+    epicsUInt32 stop,int *pam,int *pwidth)
+{
+    epicsUInt32 nbytes;
+
+    if(offset & (BLOCKBOUNDARY - 1)) {
+        epicsUInt32 boundary = (offset + BLOCKBOUNDARY) & ~(BLOCKBOUNDARY - 1);
+
+        *pam = VME_AM_EXT_SUP_DATA;
+        *pwidth = 4;
+        return((stop>boundary) ? boundary : stop);
+    }
+    *pam = VME_AM_EXT_SUP_ASCENDING;
+    *pwidth = 4;
+    if(mode<epicsDmaMBLT64) return(stop);
+    /* 64 bit modes move whole 8 byte words. A last 4 bytes go alone */
+    nbytes = (stop - offset) & ~7;
+    if(nbytes==0) {
+        *pam = VME_AM_EXT_SUP_DATA;
+        return(stop);
+    }
+    *pam = (mode==epicsDma2eSST) ? epicsDmaAmA32_2eSST : epicsDmaAmA32Mblt;
+    *pwidth = 8;
+    return(offset + nbytes);
+}
+
+/* The rest of the read is done directly, the next read tries DMA again.
+ * EBUSY means that the channel waits for a transfer that timed out, which
+ * may be another card's, so it is not counted as an error of this card.
+ */
+static void dmaFailed(gtrBtrId btr,const char *what)
+{
+    if(btr->pmemory) btr->pio = 1;
+    if(errno==EBUSY) {
+        btr->nrefused++;
+        return;
+    }
+    btr->nerror++;
+    if(btr->failing) return;
+    btr->failing = 1;
+    printf("%s: %s failed %s",btr->name,what,strerror(errno));
+    if(btr->pmemory)
+        printf(". Using direct reads until DMA works again\n");
+    else
+        printf("\n");
+}
+
+/* The next transfer for wanted bytes [beg,end), at most room bytes */
+static void nextBlock(gtrBtrId btr,btrBlock *pblock,char *pbuffer,
+    epicsUInt32 beg,epicsUInt32 end,int room)
+{
+    epicsUInt32 offset = beg & ~3;
+    epicsUInt32 stop = (end + 3) & ~3;
+
+    if(stop - offset > (epicsUInt32)room) stop = offset + room;
+    stop = transferEnd(btr->mode,offset,stop,&pblock->am,&pblock->width);
+    pblock->pbuffer = pbuffer;
+    pblock->offset = offset;
+    pblock->nbytes = stop - offset;
+    pblock->beg = beg;
+    pblock->end = (end<stop) ? end : stop;
+}
+
+/* Pass on bytes [beg,end) of segment seg, which are at pdata */
+static void deliver(gtrBtrId btr,int seg,epicsUInt32 beg,epicsUInt32 end,
+    const char *pdata)
+{
+    btrSegment *pseg = &btr->seg[seg];
+
+    if(end<=beg) return;
+    if(pseg->func) {
+        (*pseg->func)(pseg->pvt,beg - pseg->offset,pdata,end - beg);
+    } else if(pseg->pdest) {
+        const epicsInt16 *psource = (const epicsInt16 *)pdata;
+        epicsInt16 *pdest = pseg->pdest + (beg - pseg->offset)/sizeof(epicsInt16);
+        epicsInt16 mask = pseg->mask;
+        int n = (end - beg)/sizeof(epicsInt16);
+        int ind;
+
+        for(ind=0; ind<n; ind++) pdest[ind] = psource[ind]&mask;
+    } else {
+        gtrUnpackPlanBlock(&btr->plan[pseg->plan],
+            pseg->index + (beg - pseg->offset)/sizeof(epicsUInt32),
+            (const epicsUInt32 *)pdata,(end - beg)/sizeof(epicsUInt32));
+    }
+}
+
+static void deliverBatch(gtrBtrId btr,btrBatch *pbatch,int direct)
+{
+    int ind;
+
+    for(ind=0; ind<pbatch->nblock; ind++) {
+        btrBlock *pblock = &pbatch->block[ind];
+
+        deliver(btr,pblock->seg,pblock->beg,pblock->end,
+            direct ? btr->pmemory + pblock->beg
+                   : pblock->pbuffer + (pblock->beg - pblock->offset));
+    }
+}
+
+/* Pass on bytes [beg,end) of the list straight from board memory */
+static void deliverRange(gtrBtrId btr,int beg,int end)
+{
+    int pos = 0;
+    int seg;
+
+    for(seg=0; seg<btr->nseg && pos<end; seg++) {
+        btrSegment *pseg = &btr->seg[seg];
+        int first = (beg>pos) ? beg - pos : 0;
+        int last = (end<pos + pseg->nbytes) ? end - pos : pseg->nbytes;
+
+        if(last>first)
+            deliver(btr,seg,pseg->offset + first,pseg->offset + last,
+                btr->pmemory + pseg->offset + first);
+        pos += pseg->nbytes;
+    }
+}
+
+static void workerThread(void *pvt)
+{
+    btrWorker *pworker = (btrWorker *)pvt;
+    gtrBtrId btr = pworker->btr;
+
+    while(1) {
+        epicsEventMustWait(pworker->start);
+        deliverRange(btr,pworker->beg,pworker->end);
+        epicsMutexMustLock(btr->workLock);
+        if(--btr->nbusy==0) epicsEventSignal(btr->workDone);
+        epicsMutexUnlock(btr->workLock);
+    }
+}
+
+/* Start gtrBtrWorkers - 1 threads. nworker stays 1 if that fails */
+static void startWorkers(gtrBtrId btr)
+{
+    int nworker = gtrBtrWorkers;
+    int ind;
+
+    btr->nworker = 1;
+    if(nworker>MAXWORKERS) nworker = MAXWORKERS;
+    if(nworker<=1 || !btr->pmemory) return;
+    btr->worker = calloc(nworker,sizeof(btrWorker));
+    btr->workLock = epicsMutexCreate();
+    btr->workDone = epicsEventCreate(epicsEventEmpty);
+    if(!btr->worker || !btr->workLock || !btr->workDone) {
+        printf("%s: can not start workers\n",btr->name);
+        return;
+    }
+    for(ind=1; ind<nworker; ind++) {
+        btrWorker *pworker = &btr->worker[ind];
+        char name[40];
+
+        pworker->btr = btr;
+        pworker->start = epicsEventCreate(epicsEventEmpty);
+        sprintf(name,"%.30s w%d",btr->name,ind);
+        if(!pworker->start || !epicsThreadCreate(name,
+            epicsThreadGetPrioritySelf(),
+            epicsThreadGetStackSize(epicsThreadStackSmall),
+            workerThread,pworker)) {
+            printf("%s: epicsThreadCreate %s failed\n",btr->name,name);
+            break;
+        }
+        btr->nworker = ind + 1;
+    }
+}
+
+/* Unpack the whole list directly, split among the workers */
+static void readParallel(gtrBtrId btr)
+{
+    int nbytes = btr->listBytes;
+    int share = ((nbytes/btr->nworker) + 3) & ~3;
+    int ind;
+
+    btr->nparallel++;
+    epicsMutexMustLock(btr->workLock);
+    btr->nbusy = btr->nworker - 1;
+    epicsMutexUnlock(btr->workLock);
+    for(ind=1; ind<btr->nworker; ind++) {
+        btrWorker *pworker = &btr->worker[ind];
+
+        pworker->beg = (ind*share<nbytes) ? ind*share : nbytes;
+        pworker->end = (ind==btr->nworker - 1 || (ind+1)*share>nbytes)
+            ? nbytes : (ind+1)*share;
+        epicsEventSignal(pworker->start);
+    }
+    deliverRange(btr,0,(share<nbytes) ? share : nbytes);
+    epicsEventMustWait(btr->workDone);
+}
+
+/* Read everything from cursor on directly */
+static int readDirect(gtrBtrId btr,btrCursor *pcursor)
+{
+    int seg;
+
+    if(!btr->pmemory) return(-1);
+    if(btr->nworker<0) startWorkers(btr);
+    if(btr->nworker>1 && btr->nfunc==0 && btr->listBytes>=PARALLELMIN
+    && pcursor->seg==0 && pcursor->pos==btr->seg[0].offset) {
+        readParallel(btr);
+        return(0);
+    }
+    for(seg=pcursor->seg; seg<btr->nseg; seg++) {
+        btrSegment *pseg = &btr->seg[seg];
+        epicsUInt32 beg = (seg==pcursor->seg) ? pcursor->pos : pseg->offset;
+
+        deliver(btr,seg,beg,pseg->offset + pseg->nbytes,btr->pmemory + beg);
+    }
+    return(0);
+}
+
+/* Where range ind starts and ends, a region or a segment */
+static epicsUInt32 rangeOffset(gtrBtrId btr,int regions,int ind)
+{
+    return(regions ? btr->region[ind].offset : btr->seg[ind].offset);
+}
+
+static epicsUInt32 rangeEnd(gtrBtrId btr,int regions,int ind)
+{
+    return(regions ? btr->region[ind].offset + btr->region[ind].nbytes
+        : btr->seg[ind].offset + btr->seg[ind].nbytes);
+}
+
+/* Fill pbatch with the transfers from cursor on, which walks the regions
+ * if regions is true and else the segments.
+ */
+static void buildBatch(gtrBtrId btr,btrBatch *pbatch,char *pbuffer,
+    btrCursor *pcursor,int regions)
+{
+    int nrange = regions ? btr->nregion : btr->nseg;
+    int used = 0;
+
+    pbatch->start = *pcursor;
+    pbatch->pbuffer = pbuffer;
+    pbatch->nblock = 0;
+    while(pcursor->seg<nrange && pbatch->nblock<BATCHDESC) {
+        epicsUInt32 end = rangeEnd(btr,regions,pcursor->seg);
+        btrBlock *pblock = &pbatch->block[pbatch->nblock];
+        epicsDmaDesc *pdesc = &pbatch->desc[pbatch->nblock];
+
+        if(pcursor->pos>=end) {
+            if(++pcursor->seg<nrange)
+                pcursor->pos = rangeOffset(btr,regions,pcursor->seg);
+            continue;
+        }
+        if(CHUNKBYTES - used < 8) break;
+        nextBlock(btr,pblock,pbuffer + used,pcursor->pos,end,
+            CHUNKBYTES - used);
+        pblock->seg = pcursor->seg;
+        pdesc->pLocal = pblock->pbuffer;
+        pdesc->vmeAddr = btr->vmeBase + pblock->offset;
+        pdesc->adrsSpace = pblock->am;
+        pdesc->length = pblock->nbytes;
+        pdesc->dataWidth = pblock->width;
+        /* Keep the buffer 8 byte aligned for the 64 bit modes */
+        used += (pblock->nbytes + 7) & ~7;
+        pcursor->pos = pblock->end;
+        pbatch->nblock++;
+    }
+}
+
+/* Does the list have the regions the kept batches were built for? */
+static int sameList(gtrBtrId btr)
+{
+    int ind;
+
+    if(btr->nkey!=btr->nregion) return(0);
+    for(ind=0; ind<btr->nregion; ind++) {
+        if(btr->keyRegion[ind].offset!=btr->region[ind].offset
+        || btr->keyRegion[ind].nbytes!=btr->region[ind].nbytes) return(0);
+    }
+    return(1);
+}
+
+/* Make room for a batch of BATCHDESC more transfers in the cache */
+static int growCache(gtrBtrId btr)
+{
+    if(btr->ncache>=btr->maxcache) {
+        int maxcache = btr->maxcache ? 2*btr->maxcache : 8;
+        btrBatch *pnew = realloc(btr->cache,maxcache*sizeof(btrBatch));
+
+        if(!pnew) return(-1);
+        btr->cache = pnew;
+        btr->maxcache = maxcache;
+    }
+    if(btr->ncacheBlock + BATCHDESC>btr->maxcacheBlock) {
+        int maxblock = btr->maxcacheBlock ? 2*btr->maxcacheBlock : 4*BATCHDESC;
+        btrBlock *pblock;
+        epicsDmaDesc *pdesc;
+
+        pblock = realloc(btr->cacheBlock,maxblock*sizeof(btrBlock));
+        if(!pblock) return(-1);
+        btr->cacheBlock = pblock;
+        pdesc = realloc(btr->cacheDesc,maxblock*sizeof(epicsDmaDesc));
+        if(!pdesc) return(-1);
+        btr->cacheDesc = pdesc;
+        btr->maxcacheBlock = maxblock;
+    }
+    return(0);
+}
+
+/* Build and keep the batches for all regions of the list, if they fit */
+static void buildCache(gtrBtrId btr)
+{
+    btrCursor cursor;
+    int ind;
+
+    if(btr->nregion>btr->maxkey) {
+        btrRegion *pnew = realloc(btr->keyRegion,
+            btr->nregion*sizeof(btrRegion));
+
+        if(!pnew) {
+            btr->nkey = -1;
+            btr->keep = 0;
+            return;
+        }
+        btr->keyRegion = pnew;
+        btr->maxkey = btr->nregion;
+    }
+    memcpy(btr->keyRegion,btr->region,btr->nregion*sizeof(btrRegion));
+    btr->nkey = btr->nregion;
+    btr->nbuild++;
+    btr->keep = 0;
+    btr->ncache = 0;
+    btr->ncacheBlock = 0;
+    cursor.seg = 0;
+    cursor.pos = btr->region[0].offset;
+    while(cursor.seg<btr->nregion) {
+        btrBatch *pbatch;
+
+        if(btr->ncacheBlock + BATCHDESC>MAXCACHEBLOCKS) return;
+        if(growCache(btr)) return;
+        pbatch = &btr->cache[btr->ncache];
+        pbatch->first = btr->ncacheBlock;
+        pbatch->block = btr->cacheBlock + pbatch->first;
+        pbatch->desc = btr->cacheDesc + pbatch->first;
+        buildBatch(btr,pbatch,btr->buffer + (btr->ncache&1)*CHUNKBYTES,
+            &cursor,1);
+        if(pbatch->nblock==0) break;
+        btr->ncache++;
+        btr->ncacheBlock += pbatch->nblock;
+    }
+    /* block and desc of the batches built before a realloc have moved */
+    for(ind=0; ind<btr->ncache; ind++) {
+        btrBatch *pbatch = &btr->cache[ind];
+
+        pbatch->block = btr->cacheBlock + pbatch->first;
+        pbatch->desc = btr->cacheDesc + pbatch->first;
+    }
+    btr->keep = 1;
+}
+
+/* Batch ind of the list, NULL after the last one.
+ * pcursor is where batches that are not kept continue.
+ */
+static btrBatch *getBatch(gtrBtrId btr,int ind,btrCursor *pcursor)
+{
+    btrBatch *pbatch;
+
+    if(btr->keep) return((ind<btr->ncache) ? &btr->cache[ind] : 0);
+    pbatch = &btr->batch[ind&1];
+    buildBatch(btr,pbatch,btr->buffer + (ind&1)*CHUNKBYTES,pcursor,0);
+    return((pbatch->nblock>0) ? pbatch : 0);
+}
+
+/* The wanted bytes [*plo,*phi) of a kept block. Returns 0 if none */
+static int wantedRange(gtrBtrId btr,btrBlock *pblock,
+    epicsUInt32 *plo,epicsUInt32 *phi)
+{
+    btrRegion *pregion = &btr->region[pblock->seg];
+    epicsUInt32 lo = pblock->offset + pblock->nbytes;
+    epicsUInt32 hi = pblock->offset;
+    int seg;
+
+    for(seg=pregion->firstSeg; seg<pregion->firstSeg + pregion->nseg; seg++) {
+        btrSegment *pseg = &btr->seg[seg];
+        epicsUInt32 beg = pseg->offset;
+        epicsUInt32 end = pseg->offset + pseg->nbytes;
+
+        if(beg<pblock->offset) beg = pblock->offset;
+        if(end>pblock->offset + pblock->nbytes)
+            end = pblock->offset + pblock->nbytes;
+        if(end<=beg) continue;
+        if(beg<lo) lo = beg;
+        if(end>hi) hi = end;
+    }
+    *plo = lo;
+    *phi = hi;
+    return(hi>lo);
+}
+
+/* Select the blocks of a kept batch that hold wanted bytes. Block
+ * transfers may only start on a block boundary and the 64 bit modes move
+ * 8 byte words, so the first and last are only cut down that far.
+ * Blocks between them are read whether wanted or not.
+ * Returns 0 if no block is wanted.
+ */
+static int selectBlocks(gtrBtrId btr,btrBatch *pbatch)
+{
+    int ind;
+
+    pbatch->selFirst = -1;
+    for(ind=0; ind<pbatch->nblock; ind++) {
+        btrBlock *pblock = &pbatch->block[ind];
+        epicsUInt32 lo,hi;
+
+        if(!wantedRange(btr,pblock,&lo,&hi)) continue;
+        if(pbatch->selFirst<0) {
+            pbatch->selFirst = ind;
+            lo &= (pblock->am==VME_AM_EXT_SUP_DATA) ? ~3 : ~(BLOCKBOUNDARY - 1);
+            pbatch->selStart = (lo>pblock->offset) ? lo : pblock->offset;
+        }
+        pbatch->selLast = ind;
+        hi = (pblock->width==8) ? (hi + 7) & ~7 : (hi + 3) & ~3;
+        pbatch->selStop = (hi<pblock->offset + pblock->nbytes)
+            ? hi : pblock->offset + pblock->nbytes;
+    }
+    return(pbatch->selFirst>=0);
+}
+
+/* Transfer [beg,end) of a kept block into desc */
+static void setDesc(gtrBtrId btr,btrBlock *pblock,epicsDmaDesc *pdesc,
+    epicsUInt32 beg,epicsUInt32 end)
+{
+    pdesc->pLocal = pblock->pbuffer + (beg - pblock->offset);
+    pdesc->vmeAddr = btr->vmeBase + beg;
+    pdesc->length = end - beg;
+}
+
+/* Patch the first and last selected transfers to the selected bytes */
+static void patchBatch(gtrBtrId btr,btrBatch *pbatch)
+{
+    btrBlock *pfirst = &pbatch->block[pbatch->selFirst];
+    btrBlock *plast = &pbatch->block[pbatch->selLast];
+
+    if(pbatch->selFirst==pbatch->selLast) {
+        setDesc(btr,pfirst,&pbatch->desc[pbatch->selFirst],
+            pbatch->selStart,pbatch->selStop);
+        return;
+    }
+    setDesc(btr,pfirst,&pbatch->desc[pbatch->selFirst],
+        pbatch->selStart,pfirst->offset + pfirst->nbytes);
+    setDesc(btr,plast,&pbatch->desc[pbatch->selLast],
+        plast->offset,pbatch->selStop);
+}
+
+/* Undo patchBatch, once the DMA has ended */
+static void restoreBatch(gtrBtrId btr,btrBatch *pbatch)
+{
+    btrBlock *pfirst = &pbatch->block[pbatch->selFirst];
+    btrBlock *plast = &pbatch->block[pbatch->selLast];
+
+    setDesc(btr,pfirst,&pbatch->desc[pbatch->selFirst],
+        pfirst->offset,pfirst->offset + pfirst->nbytes);
+    setDesc(btr,plast,&pbatch->desc[pbatch->selLast],
+        plast->offset,plast->offset + plast->nbytes);
+}
+
+/* Pass on the wanted bytes of the selected blocks of a kept batch */
+static void deliverKept(gtrBtrId btr,btrBatch *pbatch,int direct)
+{
+    int ind;
+
+    for(ind=pbatch->selFirst; ind<=pbatch->selLast; ind++) {
+        btrBlock *pblock = &pbatch->block[ind];
+        btrRegion *pregion = &btr->region[pblock->seg];
+        epicsUInt32 from = (ind==pbatch->selFirst)
+            ? pbatch->selStart : pblock->offset;
+        epicsUInt32 to = (ind==pbatch->selLast)
+            ? pbatch->selStop : pblock->offset + pblock->nbytes;
+        int seg;
+
+        for(seg=pregion->firstSeg; seg<pregion->firstSeg + pregion->nseg;
+        seg++) {
+            btrSegment *pseg = &btr->seg[seg];
+            epicsUInt32 beg = (pseg->offset>from) ? pseg->offset : from;
+            epicsUInt32 end = pseg->offset + pseg->nbytes;
+
+            if(end>to) end = to;
+            deliver(btr,seg,beg,end,
+                direct ? btr->pmemory + beg
+                       : pblock->pbuffer + (beg - pblock->offset));
+        }
+    }
+}
+
+/* Read a list whose batches are kept. Only batches with wanted bytes are
+ * started. Two that use the same half of buffer can not overlap.
+ */
+static int readKept(gtrBtrId btr)
+{
+    btrBatch *pdone = 0;   /* batch whose data is in buffer, not passed on */
+    int inFlight = 0;      /* the DMA of pdone has not been waited for */
+    int ind;
+
+    for(ind=0; ind<btr->ncache; ind++) {
+        btrBatch *pnext = &btr->cache[ind];
+
+        if(!selectBlocks(btr,pnext)) continue;
+        if(inFlight) {
+            int status = epicsDmaWait(btr->dmaId);
+
+            inFlight = 0;
+            restoreBatch(btr,pdone);
+            if(status) {
+                dmaFailed(btr,"epicsDmaWait");
+                if(!btr->pmemory) return(-1);
+                deliverKept(btr,pdone,1);
+                pdone = 0;
+            } else {
+                btr->failing = 0;
+            }
+        }
+        if(pdone && (btr->pio || pdone->pbuffer==pnext->pbuffer)) {
+            deliverKept(btr,pdone,0);
+            pdone = 0;
+        }
+        if(btr->pio) {
+            deliverKept(btr,pnext,1);
+            continue;
+        }
+        patchBatch(btr,pnext);
+        if(epicsDmaListFromVmeStart(btr->dmaId,pnext->desc + pnext->selFirst,
+            pnext->selLast - pnext->selFirst + 1)) {
+            restoreBatch(btr,pnext);
+            dmaFailed(btr,"epicsDmaListFromVmeStart");
+            if(!btr->pmemory) return(-1);
+            deliverKept(btr,pnext,1);
+            continue;
+        }
+        btr->nlist++;
+        btr->ndma += pnext->selLast - pnext->selFirst + 1;
+        inFlight = 1;
+        if(pdone) deliverKept(btr,pdone,0);
+        pdone = pnext;
+    }
+    if(inFlight) {
+        int status = epicsDmaWait(btr->dmaId);
+
+        restoreBatch(btr,pdone);
+        if(status) {
+            dmaFailed(btr,"epicsDmaWait");
+            if(!btr->pmemory) return(-1);
+            deliverKept(btr,pdone,1);
+            return(0);
+        }
+        btr->failing = 0;
+    }
+    if(pdone) deliverKept(btr,pdone,0);
+    return(0);
+}
+
+void gtrBtrListClear(gtrBtrId btr)
+{
+    btr->nseg = 0;
+    btr->nregion = 0;
+    btr->nplan = 0;
+    btr->listBytes = 0;
+    btr->nfunc = 0;
+}
+
+/* The segment added next is read from region [offset,offset+nbytes) */
+static int addRegion(gtrBtrId btr,epicsUInt32 offset,int nbytes)
+{
+    btrRegion *pregion;
+
+    if(btr->nregion>0) {
+        pregion = &btr->region[btr->nregion - 1];
+        if(pregion->offset==offset && pregion->nbytes==nbytes) {
+            pregion->nseg++;
+            return(0);
+        }
+    }
+    if(btr->nregion>=btr->maxregion) {
+        int maxregion = btr->maxregion ? 2*btr->maxregion : 16;
+        btrRegion *pnew = realloc(btr->region,maxregion*sizeof(btrRegion));
+
+        if(!pnew) {
+            printf("%s: gtrBtrListAdd realloc failed\n",btr->name);
+            return(-1);
+        }
+        btr->region = pnew;
+        btr->maxregion = maxregion;
+    }
+    pregion = &btr->region[btr->nregion++];
+    pregion->offset = offset;
+    pregion->nbytes = nbytes;
+    pregion->firstSeg = btr->nseg;
+    pregion->nseg = 1;
+    return(0);
+}
+
+static btrSegment *addSegment(gtrBtrId btr,epicsUInt32 offset,int nbytes,
+    epicsUInt32 regionOffset,int regionBytes)
+{
+    btrSegment *pseg;
+
+    if(btr->nseg>=btr->maxseg) {
+        int maxseg = btr->maxseg ? 2*btr->maxseg : 16;
+        btrSegment *pnew = realloc(btr->seg,maxseg*sizeof(btrSegment));
+
+        if(!pnew) {
+            printf("%s: gtrBtrListAdd realloc failed\n",btr->name);
+            return(0);
+        }
+        btr->seg = pnew;
+        btr->maxseg = maxseg;
+    }
+    if(addRegion(btr,regionOffset,regionBytes)) return(0);
+    pseg = &btr->seg[btr->nseg++];
+    pseg->offset = offset;
+    pseg->nbytes = nbytes;
+    btr->listBytes += nbytes;
+    pseg->func = 0;
+    pseg->pvt = 0;
+    pseg->pdest = 0;
+    pseg->mask = 0;
+    pseg->plan = 0;
+    pseg->index = 0;
+    return(pseg);
+}
+
+int gtrBtrListAdd(gtrBtrId btr,epicsUInt32 offset,int nbytes,
+    gtrBtrBlockFunc func,void *pvt)
+{
+    btrSegment *pseg;
+
+    if(nbytes<=0) return(0);
+    pseg = addSegment(btr,offset,nbytes,offset,nbytes);
+    if(!pseg) return(-1);
+    pseg->func = func;
+    pseg->pvt = pvt;
+    btr->nfunc++;
+    return(0);
+}
+
+int gtrBtrListAddMasked(gtrBtrId btr,epicsUInt32 offset,int nbytes,
+    epicsInt16 *pdest,epicsInt16 mask)
+{
+    btrSegment *pseg;
+
+    if(nbytes<=0) return(0);
+    pseg = addSegment(btr,offset,nbytes,offset,nbytes);
+    if(!pseg) return(-1);
+    pseg->pdest = pdest;
+    pseg->mask = mask;
+    return(0);
+}
+
+int gtrBtrListAddPlan(gtrBtrId btr,epicsUInt32 offset,gtrUnpackPlan *pplan)
+{
+    int ind;
+
+    if(pplan->nspan<=0) return(0);
+    if(btr->nplan>=btr->maxplan) {
+        int maxplan = btr->maxplan ? 2*btr->maxplan : 8;
+        gtrUnpackPlan *pnew = realloc(btr->plan,maxplan*sizeof(gtrUnpackPlan));
+
+        if(!pnew) {
+            printf("%s: gtrBtrListAddPlan realloc failed\n",btr->name);
+            return(-1);
+        }
+        btr->plan = pnew;
+        btr->maxplan = maxplan;
+    }
+    btr->plan[btr->nplan] = *pplan;
+    for(ind=0; ind<pplan->nspan; ind++) {
+        gtrUnpackSpan *pspan = &pplan->span[ind];
+        btrSegment *pseg;
+
+        pseg = addSegment(btr,offset + pspan->offset*sizeof(epicsUInt32),
+            pspan->count*sizeof(epicsUInt32),
+            offset,pplan->size*sizeof(epicsUInt32));
+        if(!pseg) return(-1);
+        pseg->plan = btr->nplan;
+        pseg->index = pspan->index;
+    }
+    btr->nplan++;
+    return(0);
+}
+
+/* Batch ind uses half ind&1 of buffer, so the batch in flight never
+ * overwrites the one being passed on.
+ */
+int gtrBtrListRead(gtrBtrId btr)
+{
+    btrCursor cursor;
+    btrBatch *pdone = 0;   /* batch whose data is in buffer, not passed on */
+    int inFlight = 0;      /* the DMA of pdone has not been waited for */
+    int ind;
+
+    if(btr->nseg<=0) return(0);
+    btr->nread++;
+    btr->pio = !btr->dmaId;
+    cursor.seg = 0;
+    cursor.pos = btr->seg[0].offset;
+    if(btr->dmaId && btr->listBytes<btr->dmaMinBytes) {
+        btr->nsmall++;
+        return(readDirect(btr,&cursor));
+    }
+    if(btr->dmaId && !sameList(btr)) buildCache(btr);
+    if(btr->dmaId && btr->keep) return(readKept(btr));
+    for(ind=0; ; ind++) {
+        btrBatch *pnext;
+
+        if(inFlight) {
+            inFlight = 0;
+            if(epicsDmaWait(btr->dmaId)) {
+                dmaFailed(btr,"epicsDmaWait");
+                if(!btr->pmemory) return(-1);
+                cursor = pdone->start;
+                pdone = 0;
+            } else {
+                btr->failing = 0;
+            }
+        }
+        if(btr->pio) {
+            if(pdone) deliverBatch(btr,pdone,0);
+            return(readDirect(btr,&cursor));
+        }
+        pnext = getBatch(btr,ind,&cursor);
+        if(!pnext) break;
+        if(epicsDmaListFromVmeStart(btr->dmaId,pnext->desc,pnext->nblock)) {
+            dmaFailed(btr,"epicsDmaListFromVmeStart");
+            if(!btr->pmemory) return(-1);
+            cursor = pnext->start;
+            continue;
+        }
+        btr->nlist++;
+        btr->ndma += pnext->nblock;
+        inFlight = 1;
+        if(pdone) deliverBatch(btr,pdone,0);
+        pdone = pnext;
+    }
+    if(inFlight) {
+        if(epicsDmaWait(btr->dmaId)) {
+            dmaFailed(btr,"epicsDmaWait");
+            if(!btr->pmemory) return(-1);
+            deliverBatch(btr,pdone,1);
+            return(0);
+        }
+        btr->failing = 0;
+    }
+    if(pdone) deliverBatch(btr,pdone,0);
+    return(0);
+}
+
+int gtrBtrRead(gtrBtrId btr,epicsUInt32 offset,int nbytes,
+    gtrBtrBlockFunc func,void *pvt)
+{
+    gtrBtrListClear(btr);
+    if(gtrBtrListAdd(btr,offset,nbytes,func,pvt)) return(-1);
+    return(gtrBtrListRead(btr));
+}
+
+static void copyBlock(void *pvt,int offset,const void *pdata,int nbytes)
+{
+    memcpy((char *)pvt + offset,pdata,nbytes);
+}
+
+/* DMA [offset,offset+nbytes) to pdest, up to BATCHDESC transfers in one
+ * vectored request. offset, nbytes and pdest are multiples of 4.
+ * Returns the number of bytes read, less than nbytes if a request failed.
+ */
+static int dmaCopy(gtrBtrId btr,epicsUInt32 offset,int nbytes,char *pdest)
+{
+    int mode = btr->mode;
+    epicsUInt32 pos = offset;
+    epicsUInt32 end = offset + nbytes;
+
+    /* The 64 bit modes need pdest and offset equally aligned */
+    if(((size_t)pdest&7)!=(offset&7) && mode>epicsDmaBLT32)
+        mode = epicsDmaBLT32;
+    while(pos<end) {
+        epicsUInt32 stop = pos;
+        int ndesc;
+
+        for(ndesc=0; ndesc<BATCHDESC && stop<end; ndesc++) {
+            epicsDmaDesc *pdesc = &btr->desc[ndesc];
+            epicsUInt32 beg = stop;
+
+            stop = transferEnd(mode,beg,end,&pdesc->adrsSpace,
+                &pdesc->dataWidth);
+            pdesc->pLocal = pdest + (beg - offset);
+            pdesc->vmeAddr = btr->vmeBase + beg;
+            pdesc->length = stop - beg;
+        }
+        if(epicsDmaFromVmeV(btr->dmaId,btr->desc,ndesc)) break;
+        btr->nlist++;
+        btr->ndma += ndesc;
+        pos = stop;
+    }
+    return(pos - offset);
+}
+
+int gtrBtrCopy(gtrBtrId btr,epicsUInt32 offset,int nbytes,void *pdest)
+{
+    if(nbytes<=0) return(0);
+    if((offset&3) || (nbytes&3) || ((size_t)pdest&3))
+        return(gtrBtrRead(btr,offset,nbytes,copyBlock,pdest));
+    btr->nread++;
+    if(btr->dmaId && nbytes<btr->dmaMinBytes) {
+        btr->nsmall++;
+    } else if(btr->dmaId) {
+        int ndone = dmaCopy(btr,offset,nbytes,(char *)pdest);
+
+        if(ndone>=nbytes) {
+            btr->failing = 0;
+            return(0);
+        }
+        dmaFailed(btr,"epicsDmaFromVmeV");
+        if(!btr->pmemory) return(-1);
+        pdest = (char *)pdest + ndone;
+        nbytes -= ndone;
+        offset += ndone;
+    }
+    if(!btr->pmemory) return(-1);
+    bcopyLongs(btr->pmemory + offset,(char *)pdest,nbytes/4);
+    return(0);
+}
+
+/* Seconds per read of nbytes at offset, directly or by DMA.
+ * -1 if the DMA failed.
+ */
+static double timeRead(gtrBtrId btr,int dma,epicsUInt32 offset,
+    char *pscratch,int nbytes)
+{
+    epicsTimeStamp start,now;
+    double seconds;
+    int nreads = 0;
+
+    epicsTimeGetCurrent(&start);
+    do {
+        if(!dma) {
+            bcopyLongs(btr->pmemory + offset,pscratch,nbytes/4);
+        } else if(dmaCopy(btr,offset,nbytes,pscratch)<nbytes) {
+            return(-1.0);
+        }
+        nreads++;
+        epicsTimeGetCurrent(&now);
+        seconds = epicsTimeDiffInSeconds(&now,&start);
+    } while(seconds<CALIBRATESECONDS);
+    return(seconds/nreads);
+}
+
+void gtrBtrCalibrate(gtrBtrId btr,epicsUInt32 offset,int nbytes)
+{
+    unsigned long nlist = btr->nlist;
+    unsigned long ndma = btr->ndma;
+    char *pscratch;
+    int size = CALIBRATEMIN;
+    int ind;
+
+    btr->dmaMinBytes = 0;
+    btr->ncalibrate = 0;
+    if(!gtrBtrAutoDma || !btr->dmaId || !btr->pmemory) return;
+    pscratch = malloc(CALIBRATEMAX);
+    if(!pscratch) {
+        printf("%s: gtrBtrCalibrate malloc failed\n",btr->name);
+        return;
+    }
+    for(ind=0; ind<NCALIBRATE && size<=nbytes; ind++, size*=4) {
+        double dmaSeconds = timeRead(btr,1,offset,pscratch,size);
+
+        if(dmaSeconds<0.0) {
+            dmaFailed(btr,"gtrBtrCalibrate");
+            break;
+        }
+        btr->pioSeconds[ind] = timeRead(btr,0,offset,pscratch,size);
+        btr->dmaSeconds[ind] = dmaSeconds;
+        btr->ncalibrate = ind + 1;
+    }
+    free(pscratch);
+    btr->nlist = nlist;
+    btr->ndma = ndma;
+    if(btr->ncalibrate==0) return;
+    /* The smallest size from which DMA stays faster */
+    btr->dmaMinBytes = DMANEVER;
+    for(ind=btr->ncalibrate - 1; ind>=0; ind--) {
+        if(btr->dmaSeconds[ind]>=btr->pioSeconds[ind]) break;
+        btr->dmaMinBytes = CALIBRATEMIN << (2*ind);
+    }
+    if(btr->dmaMinBytes==CALIBRATEMIN) btr->dmaMinBytes = 0;
+}
+
+int gtrBtrReadPlan(gtrBtrId btr,epicsUInt32 offset,gtrUnpackPlan *pplan)
+{
+    gtrBtrListClear(btr);
+    if(gtrBtrListAddPlan(btr,offset,pplan)) return(-1);
+    return(gtrBtrListRead(btr));
+}
+
+void gtrBtrReport(gtrBtrId btr,int level)
+{
+    int ind;
+
+    printf("    btr vme %8.8x %s reads %lu dma lists %lu transfers %lu"
+        " errors %lu\n",
+        btr->vmeBase,modeName[gtrBtrUsesDma(btr)],
+        btr->nread,btr->nlist,btr->ndma,btr->nerror);
+    if(btr->nrefused)
+        printf("    btr %lu dma requests refused behind a timed out transfer\n",
+            btr->nrefused);
+    if(btr->dmaId && btr->dmaMinBytes==DMANEVER)
+        printf("    btr direct reads faster at all sizes, %lu reads\n",
+            btr->nsmall);
+    else if(btr->dmaId && btr->dmaMinBytes>0)
+        printf("    btr dma from %d bytes, %lu smaller reads direct\n",
+            btr->dmaMinBytes,btr->nsmall);
+    if(level>1) {
+        for(ind=0; ind<btr->ncalibrate; ind++)
+            printf("    btr %6d bytes direct %8.1f dma %8.1f usec\n",
+                CALIBRATEMIN << (2*ind),
+                btr->pioSeconds[ind]*1e6,btr->dmaSeconds[ind]*1e6);
+    }
+    if(btr->nworker>1)
+        printf("    btr %d workers, %lu reads split\n",
+            btr->nworker,btr->nparallel);
+    if(level>1 && btr->dmaId)
+        printf("    btr lists built %lu kept %s batches %d transfers %d\n",
+            btr->nbuild,btr->keep ? "yes" : "no",
+            btr->ncache,btr->ncacheBlock);
+    if(btr->dmaId) epicsDmaReport(btr->dmaId,level);
+}
@@ -0,0 +1,109 @@
+/*gtrBtr.h */
+
+/*************************************************************************
+* Copyright (c) 2002 The University of Chicago, as Operator of Argonne
+* National Laboratory, and the Regents of the University of California, as
+* Operator of Los Alamos National Laboratory. EPICS BASE Versions 3.13.7
+* and higher are distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*************************************************************************/
+
+/* VME block transfer (BTR) engine used by the VME transient recorder drivers.
+ *
+ * A gtrBtr reads board memory that starts at VME A32 address vmeBase and
+ * is mapped at pmemory. Reads use DMA when requested and epicsDma is
+ * available, and otherwise read pmemory directly.
+ *
+ * Block transfers are only started on a 256 byte boundary. A transfer that
+ * starts elsewhere is read up to the next boundary with single cycles.
+ * DMA moves 32 bit words, so ranges are widened to 4 byte boundaries and
+ * only the bytes asked for are passed on. In the 64 bit modes a last odd
+ * 32 bit word is read with a single cycle.
+ *
+ * If a DMA fails, or does not end within the epicsDma timeout, a message
+ * is printed and, when pmemory is not NULL, the rest of the read, including
+ * the failed block, is done directly. The next read tries DMA again. Boards
+ * whose memory can only be read by DMA pass pmemory NULL; their read fails.
+ * Requests refused with EBUSY behind a transfer that timed out, maybe of
+ * another card, are counted apart and are not errors of the card.
+ *
+ * If the global gtrBtrWorkers is greater than 1 when a gtrBtr first reads
+ * a list, it starts gtrBtrWorkers - 1 threads. From then on lists of plans
+ * that are read directly are unpacked by the caller and these threads
+ * together. gtrBtrListRead returns when all of them are done.
+ */
+
+#ifndef gtrBtrH
+#define gtrBtrH
+
+#include <epicsTypes.h>
+#include "epicsDma.h"
+#include "gtrUnpack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct gtrBtr *gtrBtrId;
+
+/* Called for the blocks of a gtrBtrRead in address order.
+ * offset is where pdata is relative to the start of the read.
+ */
+typedef void (*gtrBtrBlockFunc)(void *pvt,int offset,
+    const void *pdata,int nbytes);
+
+/* useDma is 0 for no DMA or the epicsDma mode asked for in the Config
+ * command and maxMode is the widest mode the board supports.
+ * The widest mode that the board and the bridge support is used.
+ * Returns NULL only if out of memory.
+ * gtrBtrUsesDma returns the mode in use, 0 if DMA is not used.
+ */
+gtrBtrId gtrBtrCreate(const char *name,epicsUInt32 vmeBase,
+    volatile void *pmemory,int useDma,int maxMode);
+int gtrBtrUsesDma(gtrBtrId btr);
+
+/* offset is relative to vmeBase. These return 0 on success and -1 if the
+ * data could not be read.
+ */
+
+/* A read list holds segments of board memory, e.g. both parts of a
+ * wrapped prePostTrigger event for every event and group. gtrBtrListRead
+ * reads all of them with chained transfers, in the order they were added.
+ * gtrBtrRead, gtrBtrReadPlan and gtrBtrListClear empty the list.
+ */
+void gtrBtrListClear(gtrBtrId btr);
+int gtrBtrListAdd(gtrBtrId btr,epicsUInt32 offset,int nbytes,
+    gtrBtrBlockFunc func,void *pvt);
+/* Copy the 16 bit words of [offset,offset+nbytes) to pdest, ANDed with
+ * mask. nbytes must be even. Blocks may arrive in any order.
+ */
+int gtrBtrListAddMasked(gtrBtrId btr,epicsUInt32 offset,int nbytes,
+    epicsInt16 *pdest,epicsInt16 mask);
+/* The spans of a plan whose buffer starts at offset. The plan is copied */
+int gtrBtrListAddPlan(gtrBtrId btr,epicsUInt32 offset,gtrUnpackPlan *pplan);
+int gtrBtrListRead(gtrBtrId btr);
+
+int gtrBtrRead(gtrBtrId btr,epicsUInt32 offset,int nbytes,
+    gtrBtrBlockFunc func,void *pvt);
+/* Copy straight into pdest. DMA goes directly into pdest if offset, nbytes
+ * and pdest are multiples of 4 bytes. The read list is then left alone.
+ */
+int gtrBtrCopy(gtrBtrId btr,epicsUInt32 offset,int nbytes,void *pdest);
+/* Read and unpack the spans of a plan whose buffer starts at offset */
+int gtrBtrReadPlan(gtrBtrId btr,epicsUInt32 offset,gtrUnpackPlan *pplan);
+
+/* Called by the driver init. Times direct and DMA reads of growing size
+ * from board memory [offset,offset+nbytes), which must be safe to read,
+ * and from then on does reads that are too small for DMA to win directly.
+ * Does nothing without DMA, without pmemory or if the global
+ * gtrBtrAutoDma is 0.
+ */
+void gtrBtrCalibrate(gtrBtrId btr,epicsUInt32 offset,int nbytes);
+
+void gtrBtrReport(gtrBtrId btr,int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*gtrBtrH*/
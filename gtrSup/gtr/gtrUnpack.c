@@ -0,0 +1,606 @@
+/*gtrUnpack.c */
+
+/*************************************************************************
+* Copyright (c) 2002 The University of Chicago, as Operator of Argonne
+* National Laboratory, and the Regents of the University of California, as
+* Operator of Los Alamos National Laboratory. EPICS BASE Versions 3.13.7
+* and higher are distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*************************************************************************/
+
+/* The kernel is selected at compile time from the compiler target.
+ * AltiVec is not used on vxWorks because only tasks spawned with
+ * VX_ALTIVEC_TASK have the vector registers saved on a context switch.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include <epicsTypes.h>
+#include <menuFtype.h>
+
+#include "drvGtr.h"
+#include "gtrUnpack.h"
+
+#if defined(__AVX2__)
+#define GTR_UNPACK_AVX2
+#define GTR_UNPACK_SSE2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#define GTR_UNPACK_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && !defined(__ARM_BIG_ENDIAN)
+#define GTR_UNPACK_NEON
+#include <arm_neon.h>
+#elif defined(__ALTIVEC__) && defined(__BIG_ENDIAN__) && !defined(vxWorks)
+#define GTR_UNPACK_ALTIVEC
+#include <altivec.h>
+#endif
+
+#if defined(GTR_UNPACK_AVX2)
+static const char *kernelName = "AVX2";
+#elif defined(GTR_UNPACK_SSE2)
+static const char *kernelName = "SSE2";
+#elif defined(GTR_UNPACK_NEON)
+static const char *kernelName = "NEON";
+#elif defined(GTR_UNPACK_ALTIVEC)
+static const char *kernelName = "AltiVec";
+#else
+static const char *kernelName = "scalar";
+#endif
+
+#ifdef GTR_UNPACK_SSE2
+/* srai then packs is exact for every 16 bit value, including the SIS G bit */
+#define sse2High(A,B) _mm_packs_epi32(_mm_srai_epi32(A,16),_mm_srai_epi32(B,16))
+#define sse2Low(A,B) _mm_packs_epi32( \
+    _mm_srai_epi32(_mm_slli_epi32(A,16),16), \
+    _mm_srai_epi32(_mm_slli_epi32(B,16),16))
+#endif
+
+#ifdef GTR_UNPACK_AVX2
+/* packs works within 128 bit lanes. 0xd8 puts the quadwords back in order */
+#define avx2High(A,B) _mm256_permute4x64_epi64(_mm256_packs_epi32( \
+    _mm256_srai_epi32(A,16),_mm256_srai_epi32(B,16)),0xd8)
+#define avx2Low(A,B) _mm256_permute4x64_epi64(_mm256_packs_epi32( \
+    _mm256_srai_epi32(_mm256_slli_epi32(A,16),16), \
+    _mm256_srai_epi32(_mm256_slli_epi32(B,16),16)),0xd8)
+#endif
+
+#ifdef GTR_UNPACK_ALTIVEC
+/* Big endian, so the high half of word n is bytes 4n and 4n+1 */
+static const vector unsigned char permHigh = {
+    0,1,4,5,8,9,12,13,16,17,20,21,24,25,28,29};
+static const vector unsigned char permLow = {
+    2,3,6,7,10,11,14,15,18,19,22,23,26,27,30,31};
+
+/* vec_ld rounds the address down, which for an unaligned psource reads
+ * before the start of the buffer, so unaligned words are copied first */
+static vector unsigned char altivecLoad(const epicsUInt32 *psource)
+{
+    union {
+        vector unsigned char v;
+        epicsUInt32 w[4];
+    } buf;
+
+    if(((size_t)psource&0xf)==0)
+        return(vec_ld(0,(const unsigned char *)psource));
+    memcpy(buf.w,psource,sizeof(buf.w));
+    return(buf.v);
+}
+
+static void altivecStore(vector unsigned short value,epicsInt16 *pdest)
+{
+    union {
+        vector unsigned short v;
+        epicsInt16 s[8];
+    } buf;
+
+    if(((size_t)pdest&0xf)==0) {
+        vec_st(value,0,(unsigned short *)pdest);
+        return;
+    }
+    buf.v = value;
+    memcpy(pdest,buf.s,sizeof(buf.s));
+}
+#endif
+
+void gtrUnpackPair(const epicsUInt32 *psource,int nwords,
+    epicsInt16 *phigh,epicsUInt16 highMask,
+    epicsInt16 *plow,epicsUInt16 lowMask)
+{
+    int ind = 0;
+
+#ifdef GTR_UNPACK_AVX2
+    {
+        __m256i vhigh = _mm256_set1_epi16((short)highMask);
+        __m256i vlow = _mm256_set1_epi16((short)lowMask);
+
+        for(; ind+16<=nwords; ind+=16) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(psource + ind));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(psource + ind + 8));
+
+            _mm256_storeu_si256((__m256i *)(phigh + ind),
+                _mm256_and_si256(avx2High(a,b),vhigh));
+            _mm256_storeu_si256((__m256i *)(plow + ind),
+                _mm256_and_si256(avx2Low(a,b),vlow));
+        }
+    }
+#endif
+#if defined(GTR_UNPACK_SSE2)
+    {
+        __m128i vhigh = _mm_set1_epi16((short)highMask);
+        __m128i vlow = _mm_set1_epi16((short)lowMask);
+
+        for(; ind+8<=nwords; ind+=8) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(psource + ind));
+            __m128i b = _mm_loadu_si128((const __m128i *)(psource + ind + 4));
+
+            _mm_storeu_si128((__m128i *)(phigh + ind),
+                _mm_and_si128(sse2High(a,b),vhigh));
+            _mm_storeu_si128((__m128i *)(plow + ind),
+                _mm_and_si128(sse2Low(a,b),vlow));
+        }
+    }
+#elif defined(GTR_UNPACK_NEON)
+    {
+        uint16x8_t vhigh = vdupq_n_u16(highMask);
+        uint16x8_t vlow = vdupq_n_u16(lowMask);
+
+        for(; ind+8<=nwords; ind+=8) {
+            /* Little endian, so val[0] holds the low halves */
+            uint16x8x2_t v = vld2q_u16((const uint16_t *)(psource + ind));
+
+            vst1q_u16((uint16_t *)(phigh + ind),vandq_u16(v.val[1],vhigh));
+            vst1q_u16((uint16_t *)(plow + ind),vandq_u16(v.val[0],vlow));
+        }
+    }
+#elif defined(GTR_UNPACK_ALTIVEC)
+    {
+        vector unsigned short vhigh = vec_splats((unsigned short)highMask);
+        vector unsigned short vlow = vec_splats((unsigned short)lowMask);
+
+        for(; ind+8<=nwords; ind+=8) {
+            vector unsigned char a = altivecLoad(psource + ind);
+            vector unsigned char b = altivecLoad(psource + ind + 4);
+
+            altivecStore(vec_and((vector unsigned short)vec_perm(a,b,permHigh),
+                vhigh),phigh + ind);
+            altivecStore(vec_and((vector unsigned short)vec_perm(a,b,permLow),
+                vlow),plow + ind);
+        }
+    }
+#endif
+    for(; ind<nwords; ind++) {
+        epicsUInt32 word = psource[ind];
+
+        phigh[ind] = (epicsInt16)((word>>16)&highMask);
+        plow[ind] = (epicsInt16)(word&lowMask);
+    }
+}
+
+void gtrUnpackHigh(const epicsUInt32 *psource,int nwords,
+    epicsInt16 *pdest,epicsUInt16 mask)
+{
+    int ind = 0;
+
+#ifdef GTR_UNPACK_AVX2
+    {
+        __m256i vmask = _mm256_set1_epi16((short)mask);
+
+        for(; ind+16<=nwords; ind+=16) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(psource + ind));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(psource + ind + 8));
+
+            _mm256_storeu_si256((__m256i *)(pdest + ind),
+                _mm256_and_si256(avx2High(a,b),vmask));
+        }
+    }
+#endif
+#if defined(GTR_UNPACK_SSE2)
+    {
+        __m128i vmask = _mm_set1_epi16((short)mask);
+
+        for(; ind+8<=nwords; ind+=8) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(psource + ind));
+            __m128i b = _mm_loadu_si128((const __m128i *)(psource + ind + 4));
+
+            _mm_storeu_si128((__m128i *)(pdest + ind),
+                _mm_and_si128(sse2High(a,b),vmask));
+        }
+    }
+#elif defined(GTR_UNPACK_NEON)
+    {
+        uint16x8_t vmask = vdupq_n_u16(mask);
+
+        for(; ind+8<=nwords; ind+=8) {
+            uint16x8x2_t v = vld2q_u16((const uint16_t *)(psource + ind));
+
+            vst1q_u16((uint16_t *)(pdest + ind),vandq_u16(v.val[1],vmask));
+        }
+    }
+#elif defined(GTR_UNPACK_ALTIVEC)
+    {
+        vector unsigned short vmask = vec_splats((unsigned short)mask);
+
+        for(; ind+8<=nwords; ind+=8) {
+            vector unsigned char a = altivecLoad(psource + ind);
+            vector unsigned char b = altivecLoad(psource + ind + 4);
+
+            altivecStore(vec_and((vector unsigned short)vec_perm(a,b,permHigh),
+                vmask),pdest + ind);
+        }
+    }
+#endif
+    for(; ind<nwords; ind++)
+        pdest[ind] = (epicsInt16)((psource[ind]>>16)&mask);
+}
+
+void gtrUnpackLow(const epicsUInt32 *psource,int nwords,
+    epicsInt16 *pdest,epicsUInt16 mask)
+{
+    int ind = 0;
+
+#ifdef GTR_UNPACK_AVX2
+    {
+        __m256i vmask = _mm256_set1_epi16((short)mask);
+
+        for(; ind+16<=nwords; ind+=16) {
+            __m256i a = _mm256_loadu_si256((const __m256i *)(psource + ind));
+            __m256i b = _mm256_loadu_si256((const __m256i *)(psource + ind + 8));
+
+            _mm256_storeu_si256((__m256i *)(pdest + ind),
+                _mm256_and_si256(avx2Low(a,b),vmask));
+        }
+    }
+#endif
+#if defined(GTR_UNPACK_SSE2)
+    {
+        __m128i vmask = _mm_set1_epi16((short)mask);
+
+        for(; ind+8<=nwords; ind+=8) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(psource + ind));
+            __m128i b = _mm_loadu_si128((const __m128i *)(psource + ind + 4));
+
+            _mm_storeu_si128((__m128i *)(pdest + ind),
+                _mm_and_si128(sse2Low(a,b),vmask));
+        }
+    }
+#elif defined(GTR_UNPACK_NEON)
+    {
+        uint16x8_t vmask = vdupq_n_u16(mask);
+
+        for(; ind+8<=nwords; ind+=8) {
+            uint16x8x2_t v = vld2q_u16((const uint16_t *)(psource + ind));
+
+            vst1q_u16((uint16_t *)(pdest + ind),vandq_u16(v.val[0],vmask));
+        }
+    }
+#elif defined(GTR_UNPACK_ALTIVEC)
+    {
+        vector unsigned short vmask = vec_splats((unsigned short)mask);
+
+        for(; ind+8<=nwords; ind+=8) {
+            vector unsigned char a = altivecLoad(psource + ind);
+            vector unsigned char b = altivecLoad(psource + ind + 4);
+
+            altivecStore(vec_and((vector unsigned short)vec_perm(a,b,permLow),
+                vmask),pdest + ind);
+        }
+    }
+#endif
+    for(; ind<nwords; ind++)
+        pdest[ind] = (epicsInt16)(psource[ind]&mask);
+}
+
+void gtrUnpackScaleFloat(const epicsInt16 *psource,int n,
+    float *pdest,float scale,float offset)
+{
+    int ind = 0;
+
+#ifdef GTR_UNPACK_AVX2
+    {
+        __m256 vscale = _mm256_set1_ps(scale);
+        __m256 voffset = _mm256_set1_ps(offset);
+
+        for(; ind+8<=n; ind+=8) {
+            __m256i v = _mm256_cvtepi16_epi32(
+                _mm_loadu_si128((const __m128i *)(psource + ind)));
+
+            _mm256_storeu_ps(pdest + ind,_mm256_add_ps(
+                _mm256_mul_ps(_mm256_cvtepi32_ps(v),vscale),voffset));
+        }
+    }
+#endif
+#if defined(GTR_UNPACK_SSE2)
+    {
+        __m128 vscale = _mm_set1_ps(scale);
+        __m128 voffset = _mm_set1_ps(offset);
+
+        for(; ind+8<=n; ind+=8) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(psource + ind));
+            /* Each value in the high half of a word, then sign extended */
+            __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v,v),16);
+            __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v,v),16);
+
+            _mm_storeu_ps(pdest + ind,_mm_add_ps(
+                _mm_mul_ps(_mm_cvtepi32_ps(a),vscale),voffset));
+            _mm_storeu_ps(pdest + ind + 4,_mm_add_ps(
+                _mm_mul_ps(_mm_cvtepi32_ps(b),vscale),voffset));
+        }
+    }
+#elif defined(GTR_UNPACK_NEON)
+    {
+        float32x4_t vscale = vdupq_n_f32(scale);
+        float32x4_t voffset = vdupq_n_f32(offset);
+
+        for(; ind+8<=n; ind+=8) {
+            int16x8_t v = vld1q_s16(psource + ind);
+
+            vst1q_f32(pdest + ind,vmlaq_f32(voffset,
+                vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))),vscale));
+            vst1q_f32(pdest + ind + 4,vmlaq_f32(voffset,
+                vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))),vscale));
+        }
+    }
+#endif
+    for(; ind<n; ind++)
+        pdest[ind] = (float)psource[ind]*scale + offset;
+}
+
+void gtrUnpackScaleDouble(const epicsInt16 *psource,int n,
+    double *pdest,double scale,double offset)
+{
+    int ind = 0;
+
+#ifdef GTR_UNPACK_AVX2
+    {
+        __m256d vscale = _mm256_set1_pd(scale);
+        __m256d voffset = _mm256_set1_pd(offset);
+
+        for(; ind+4<=n; ind+=4) {
+            __m128i v = _mm_cvtepi16_epi32(
+                _mm_loadl_epi64((const __m128i *)(psource + ind)));
+
+            _mm256_storeu_pd(pdest + ind,_mm256_add_pd(
+                _mm256_mul_pd(_mm256_cvtepi32_pd(v),vscale),voffset));
+        }
+    }
+#endif
+#if defined(GTR_UNPACK_SSE2)
+    {
+        __m128d vscale = _mm_set1_pd(scale);
+        __m128d voffset = _mm_set1_pd(offset);
+
+        for(; ind+4<=n; ind+=4) {
+            __m128i v = _mm_loadl_epi64((const __m128i *)(psource + ind));
+            __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v,v),16);
+
+            _mm_storeu_pd(pdest + ind,_mm_add_pd(
+                _mm_mul_pd(_mm_cvtepi32_pd(a),vscale),voffset));
+            _mm_storeu_pd(pdest + ind + 2,_mm_add_pd(
+                _mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(a,8)),vscale),
+                voffset));
+        }
+    }
+#endif
+    for(; ind<n; ind++)
+        pdest[ind] = (double)psource[ind]*scale + offset;
+}
+
+#define TILEWORDS 256
+
+static int isScaled(int ftvl)
+{
+    return(ftvl==menuFtypeFLOAT || ftvl==menuFtypeDOUBLE);
+}
+
+static int elementSize(int ftvl)
+{
+    if(ftvl==menuFtypeFLOAT) return(sizeof(float));
+    if(ftvl==menuFtypeDOUBLE) return(sizeof(double));
+    return(sizeof(epicsInt16));
+}
+
+/* Where readout word goes in an epicsInt16 channel */
+static epicsInt16 *shortDest(gtrUnpackChannelPlan *pc,int word)
+{
+    return((epicsInt16 *)pc->pdest + (word - pc->first));
+}
+
+/* Channel words [beg,beg+n), unpacked to ptile, go to the channel */
+static void storeTile(gtrUnpackChannelPlan *pc,int beg,
+    const epicsInt16 *ptile,int n)
+{
+    if(pc->ftvl==menuFtypeFLOAT) {
+        gtrUnpackScaleFloat(ptile,n,(float *)pc->pdest + (beg - pc->first),
+            (float)pc->scale,(float)pc->offset);
+    } else if(pc->ftvl==menuFtypeDOUBLE) {
+        gtrUnpackScaleDouble(ptile,n,(double *)pc->pdest + (beg - pc->first),
+            pc->scale,pc->offset);
+    } else {
+        memcpy(shortDest(pc,beg),ptile,n*sizeof(epicsInt16));
+    }
+}
+
+static void channelPlan(gtrUnpackChannelPlan *pplan,int nwords,
+    gtrchannel *pchannel,epicsUInt16 mask,int nskip)
+{
+    int room = pchannel->len - pchannel->ndata;
+
+    if(nskip<0) nskip = 0;
+    if(nskip>nwords) nskip = nwords;
+    if(room<0) room = 0;
+    if(room>nwords - nskip) room = nwords - nskip;
+    pplan->pchannel = pchannel;
+    pplan->ftvl = pchannel->ftvl;
+    pplan->scale = pchannel->scale;
+    pplan->offset = pchannel->offset;
+    pplan->pdest = (room>0) ? (char *)pchannel->pdata
+        + pchannel->ndata*elementSize(pchannel->ftvl) : 0;
+    pplan->mask = mask;
+    pplan->ndata = pchannel->ndata;
+    pplan->first = nskip;
+    pplan->count = room;
+    pchannel->ndata += room;
+}
+
+void gtrUnpackPlanMake(gtrUnpackPlan *pplan,int size,int start,int nwords,
+    gtrchannel *phigh,epicsUInt16 highMask,int nskipHigh,
+    gtrchannel *plow,epicsUInt16 lowMask,int nskipLow)
+{
+    gtrUnpackChannelPlan *pchigh = &pplan->high;
+    gtrUnpackChannelPlan *pclow = &pplan->low;
+    int beg,end,offset;
+
+    if(nwords<0) nwords = 0;
+    if(nwords>size) nwords = size;
+    channelPlan(pchigh,nwords,phigh,highMask,nskipHigh);
+    channelPlan(pclow,nwords,plow,lowMask,nskipLow);
+    pplan->size = size;
+    pplan->nspan = 0;
+    if(pchigh->count<=0 && pclow->count<=0) return;
+    /* Words no channel wants are not read at all */
+    if(pchigh->count<=0) {
+        beg = pclow->first;
+        end = pclow->first + pclow->count;
+    } else if(pclow->count<=0) {
+        beg = pchigh->first;
+        end = pchigh->first + pchigh->count;
+    } else {
+        beg = (pchigh->first<pclow->first) ? pchigh->first : pclow->first;
+        end = pchigh->first + pchigh->count;
+        if(end<pclow->first + pclow->count) end = pclow->first + pclow->count;
+    }
+    offset = (start + beg)%size;
+    pplan->span[0].index = beg;
+    pplan->span[0].offset = offset;
+    pplan->span[0].count = end - beg;
+    pplan->nspan = 1;
+    if(offset + (end - beg) > size) {
+        pplan->span[0].count = size - offset;
+        pplan->span[1].index = beg + pplan->span[0].count;
+        pplan->span[1].offset = 0;
+        pplan->span[1].count = end - pplan->span[1].index;
+        pplan->nspan = 2;
+    }
+}
+
+/* Readout words [beg,end) go to the channel. psource holds word index */
+static void unpackHigh(gtrUnpackPlan *pplan,const epicsUInt32 *psource,
+    int index,int beg,int end)
+{
+    gtrUnpackChannelPlan *pc = &pplan->high;
+    epicsInt16 tile[TILEWORDS];
+
+    if(end<=beg) return;
+    if(!isScaled(pc->ftvl)) {
+        gtrUnpackHigh(psource + (beg - index),end - beg,
+            shortDest(pc,beg),pc->mask);
+        return;
+    }
+    for(; beg<end; beg+=TILEWORDS) {
+        int n = (end - beg<TILEWORDS) ? end - beg : TILEWORDS;
+
+        gtrUnpackHigh(psource + (beg - index),n,tile,pc->mask);
+        storeTile(pc,beg,tile,n);
+    }
+}
+
+static void unpackLow(gtrUnpackPlan *pplan,const epicsUInt32 *psource,
+    int index,int beg,int end)
+{
+    gtrUnpackChannelPlan *pc = &pplan->low;
+    epicsInt16 tile[TILEWORDS];
+
+    if(end<=beg) return;
+    if(!isScaled(pc->ftvl)) {
+        gtrUnpackLow(psource + (beg - index),end - beg,
+            shortDest(pc,beg),pc->mask);
+        return;
+    }
+    for(; beg<end; beg+=TILEWORDS) {
+        int n = (end - beg<TILEWORDS) ? end - beg : TILEWORDS;
+
+        gtrUnpackLow(psource + (beg - index),n,tile,pc->mask);
+        storeTile(pc,beg,tile,n);
+    }
+}
+
+/* Readout words [beg,end) go to both channels */
+static void unpackPair(gtrUnpackPlan *pplan,const epicsUInt32 *psource,
+    int index,int beg,int end)
+{
+    gtrUnpackChannelPlan *pchigh = &pplan->high;
+    gtrUnpackChannelPlan *pclow = &pplan->low;
+    epicsInt16 tileHigh[TILEWORDS];
+    epicsInt16 tileLow[TILEWORDS];
+
+    if(!isScaled(pchigh->ftvl) && !isScaled(pclow->ftvl)) {
+        gtrUnpackPair(psource + (beg - index),end - beg,
+            shortDest(pchigh,beg),pchigh->mask,
+            shortDest(pclow,beg),pclow->mask);
+        return;
+    }
+    for(; beg<end; beg+=TILEWORDS) {
+        int n = (end - beg<TILEWORDS) ? end - beg : TILEWORDS;
+
+        gtrUnpackPair(psource + (beg - index),n,
+            tileHigh,pchigh->mask,tileLow,pclow->mask);
+        storeTile(pchigh,beg,tileHigh,n);
+        storeTile(pclow,beg,tileLow,n);
+    }
+}
+
+/* The part of the channel range that lies in [index,index+nwords) */
+static void blockRange(gtrUnpackChannelPlan *pc,int index,int nwords,
+    int *pbeg,int *pend)
+{
+    int beg = pc->first;
+    int end = pc->first + pc->count;
+
+    if(beg<index) beg = index;
+    if(end>index + nwords) end = index + nwords;
+    if(end<beg) end = beg;
+    *pbeg = beg;
+    *pend = end;
+}
+
+void gtrUnpackPlanBlock(gtrUnpackPlan *pplan,int index,
+    const epicsUInt32 *psource,int nwords)
+{
+    gtrUnpackChannelPlan *pchigh = &pplan->high;
+    gtrUnpackChannelPlan *pclow = &pplan->low;
+    int begHigh,endHigh,begLow,endLow,beg,end;
+
+    blockRange(pchigh,index,nwords,&begHigh,&endHigh);
+    blockRange(pclow,index,nwords,&begLow,&endLow);
+    beg = (begHigh>begLow) ? begHigh : begLow;
+    end = (endHigh<endLow) ? endHigh : endLow;
+    if(beg<end) {
+        unpackHigh(pplan,psource,index,begHigh,beg);
+        unpackLow(pplan,psource,index,begLow,beg);
+        unpackPair(pplan,psource,index,beg,end);
+        unpackHigh(pplan,psource,index,end,endHigh);
+        unpackLow(pplan,psource,index,end,endLow);
+    } else {
+        unpackHigh(pplan,psource,index,begHigh,endHigh);
+        unpackLow(pplan,psource,index,begLow,endLow);
+    }
+}
+
+void gtrUnpackPlanRun(gtrUnpackPlan *pplan,const epicsUInt32 *pbuffer)
+{
+    int ind;
+
+    for(ind=0; ind<pplan->nspan; ind++) {
+        gtrUnpackSpan *pspan = &pplan->span[ind];
+
+        gtrUnpackPlanBlock(pplan,pspan->index,
+            pbuffer + pspan->offset,pspan->count);
+    }
+}
+
+const char *gtrUnpackKernel(void)
+{
+    return(kernelName);
+}
@@ -0,0 +1,104 @@
+/*gtrUnpack.h */
+
+/*************************************************************************
+* Copyright (c) 2002 The University of Chicago, as Operator of Argonne
+* National Laboratory, and the Regents of the University of California, as
+* Operator of Los Alamos National Laboratory. EPICS BASE Versions 3.13.7
+* and higher are distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*************************************************************************/
+
+/* Several recorders store two channels in each 32 bit memory word,
+ * one channel in the high and the other in the low 16 bits.
+ * These routines split a block of such words into two epicsInt16 arrays,
+ * using SSE2, AVX2, NEON or AltiVec when the compiler targets it.
+ *
+ * psource must be ordinary memory or memory that may be read with wide
+ * loads. The words are in host byte order, i.e. as read with a uint32 load.
+ *
+ * gtrUnpackScaleFloat and gtrUnpackScaleDouble turn epicsInt16 values
+ * into value*scale + offset. Plans use them for FLOAT and DOUBLE channels,
+ * a few hundred words at a time, so that the channel data is written once.
+ */
+
+#ifndef gtrUnpackH
+#define gtrUnpackH
+
+#include <epicsTypes.h>
+#include "drvGtr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void gtrUnpackPair(const epicsUInt32 *psource,int nwords,
+    epicsInt16 *phigh,epicsUInt16 highMask,
+    epicsInt16 *plow,epicsUInt16 lowMask);
+void gtrUnpackHigh(const epicsUInt32 *psource,int nwords,
+    epicsInt16 *pdest,epicsUInt16 mask);
+void gtrUnpackLow(const epicsUInt32 *psource,int nwords,
+    epicsInt16 *pdest,epicsUInt16 mask);
+void gtrUnpackScaleFloat(const epicsInt16 *psource,int n,
+    float *pdest,float scale,float offset);
+void gtrUnpackScaleDouble(const epicsInt16 *psource,int n,
+    double *pdest,double scale,double offset);
+
+/* A plan for reading nwords words, starting at word start of a circular
+ * buffer of size words, into phigh and plow starting at their ndata.
+ * The first nskipHigh and nskipLow words are skipped for each channel and
+ * neither channel is written beyond len. The ranges are worked out once by
+ * gtrUnpackPlanMake, so the copy loops have no per word tests.
+ * The words that must be read are given by span, in readout order, as
+ * offsets into the buffer. There are two spans when the readout wraps.
+ * gtrUnpackPlanMake already advances the ndata of both channels, so the
+ * plans for several events can be made before any of them is run.
+ * FLOAT and DOUBLE channels get masked value*scale + offset, the scale and
+ * offset of the channel. All other channels get epicsInt16 values.
+ */
+typedef struct gtrUnpackChannelPlan {
+    gtrchannel  *pchannel;
+    void        *pdest;   /* where readout word first goes */
+    int         ftvl;
+    double      scale;
+    double      offset;
+    epicsUInt16 mask;
+    int         ndata;    /* pchannel->ndata before the plan was made */
+    int         first;    /* first readout word copied to the channel */
+    int         count;    /* number of words copied to the channel */
+} gtrUnpackChannelPlan;
+
+typedef struct gtrUnpackSpan {
+    int index;    /* readout word number of the first word */
+    int offset;   /* offset of the first word in the buffer */
+    int count;
+} gtrUnpackSpan;
+
+typedef struct gtrUnpackPlan {
+    gtrUnpackChannelPlan high;
+    gtrUnpackChannelPlan low;
+    int                  size;     /* words in the circular buffer */
+    int                  nspan;
+    gtrUnpackSpan        span[2];
+} gtrUnpackPlan;
+
+void gtrUnpackPlanMake(gtrUnpackPlan *pplan,int size,int start,int nwords,
+    gtrchannel *phigh,epicsUInt16 highMask,int nskipHigh,
+    gtrchannel *plow,epicsUInt16 lowMask,int nskipLow);
+/* Unpack readout words [index,index+nwords), which are at psource.
+ * It keeps no state, so blocks may be given in any size and in any order,
+ * e.g. the parts of a wrapped span in address order or from several
+ * threads, as long as each word is given once.
+ */
+void gtrUnpackPlanBlock(gtrUnpackPlan *pplan,int index,
+    const epicsUInt32 *psource,int nwords);
+/* Unpack every span from pbuffer, the start of the circular buffer */
+void gtrUnpackPlanRun(gtrUnpackPlan *pplan,const epicsUInt32 *pbuffer);
+
+/* Name of the kernel selected at compile time */
+const char *gtrUnpackKernel(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*gtrUnpackH*/
@@ -0,0 +1,635 @@
+/*drvGtrSim.c */
+
+/* Software transient recorder.
+ * Implements the complete gtrops table without any hardware so that
+ * devGtr and the I/O Intr readout path can be run on any host.
+ * A thread emulates the trigger at a configurable rate and the
+ * waveforms are taken from a precomputed table of synthetic signals.
+ * startReadMemory hands the read to the same thread, the way a board
+ * with DMA would do it on its own.
+ */
+
+/*************************************************************************
+* Copyright (c) 2002 The University of Chicago, as Operator of Argonne
+* National Laboratory, and the Regents of the University of California, as
+* Operator of Los Alamos National Laboratory. EPICS BASE Versions 3.13.7
+* and higher are distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <menuFtype.h>
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsTime.h>
+#include <epicsThread.h>
+#include <epicsExit.h>
+#include <epicsExport.h>
+
+#include "ellLib.h"
+#include "errlog.h"
+#include "drvSup.h"
+
+#include "drvGtr.h"
+#include "drvGtrSim.h"
+
+#define STATIC static
+
+#define SIMMASK   0x3fff
+#define SIMRANGE  (SIMMASK + 1)
+#define SIMMAXCHANNELS 32
+
+#define nclockChoices 4
+static char *clockChoices[nclockChoices] = {
+    "100 MHz","50 MHz","25 MHz","10 MHz"
+};
+
+typedef enum {triggerSoft,triggerInternal} triggerType;
+#define ntriggerChoices 2
+static char *triggerChoices[ntriggerChoices] = {
+    "soft","internal"
+};
+
+#define nmultiEventChoices 5
+static char *multiEventChoices[nmultiEventChoices] = {
+    "1","2","4","8","16"
+};
+static int numberEvents[nmultiEventChoices] = {1,2,4,8,16};
+
+typedef enum { armDisarm, armPostTrigger, armPrePostTrigger } armType;
+#define narmChoices 3
+static char *armChoices[narmChoices] = {
+    "disarm","postTrigger","prePostTrigger"
+};
+
+typedef struct simInfo {
+    ELLNODE     node;
+    int         card;
+    char        *name;
+    int         nchannels;
+    int         samples;    /* samples per channel held by the "board" */
+    double      rateHz;
+    epicsMutexId lock;
+    epicsEventId wakeup;
+    epicsThreadId tid;
+    int         clock;
+    triggerType trigger;
+    int         indMultiEventNumber;
+    armType     arm;
+    armType     firedArm;   /* arm when the last trigger came */
+    int         numberPTS;
+    int         numberPPS;
+    int         numberPTE;
+    int         softTriggerPending;
+    gtrchannel  **papreadChannel;  /* startReadMemory not done, else NULL */
+    gtrReadDone readDone;
+    void        *readDonePvt;
+    gtrhandler  usrIH;
+    void        *handlerPvt;
+    epicsInt16  **table;    /* nchannels waveforms of samples elements */
+    int         phase;      /* start of the current event in table */
+    unsigned long ntriggers;
+    unsigned long nreads;
+} simInfo;
+
+static ELLLIST simList;
+static int simIsInited = 0;
+static int isRebooting;
+
+static void simReboot(void *arg)
+{
+    simInfo *psimInfo;
+
+    isRebooting = 1;
+    psimInfo = (simInfo *)ellFirst(&simList);
+    while(psimInfo) {
+        psimInfo->arm = armDisarm;
+        epicsEventSignal(psimInfo->wakeup);
+        psimInfo = (simInfo *)ellNext(&psimInfo->node);
+    }
+}
+
+static void initialize()
+{
+    if(simIsInited) return;
+    simIsInited=1;
+    isRebooting = 0;
+    ellInit(&simList);
+    epicsAtExit(simReboot,NULL);
+}
+
+/*
+ * Each channel gets a sine of a different frequency on top of an offset
+ * and a little deterministic noise, so channels can be told apart on a
+ * display and data corruption is easy to spot.
+ */
+static void fillTable(simInfo *psimInfo)
+{
+    int signal,ind;
+    unsigned int noise = 12345;
+
+    for(signal=0; signal<psimInfo->nchannels; signal++) {
+        epicsInt16 *p = psimInfo->table[signal];
+        double cycles = (double)(signal + 1);
+        double amplitude = 0.4*SIMRANGE;
+
+        for(ind=0; ind<psimInfo->samples; ind++) {
+            double value;
+
+            noise = noise*1103515245 + 12345;
+            value = SIMRANGE/2
+                + amplitude*sin(2.0*M_PI*cycles*ind/psimInfo->samples)
+                + (double)((noise>>16)&0x3f) - 32.0;
+            p[ind] = ((epicsInt16)value)&SIMMASK;
+        }
+    }
+}
+
+/*
+ * Emulates an interrupt. Like the real boards the sim disarms itself
+ * when the trigger arrives so that autoRestart must rearm it.
+ */
+static void simFire(simInfo *psimInfo)
+{
+    gtrhandler usrIH;
+    void *handlerPvt;
+
+    epicsMutexLock(psimInfo->lock);
+    if(psimInfo->arm==armDisarm) {
+        epicsMutexUnlock(psimInfo->lock);
+        return;
+    }
+    psimInfo->firedArm = psimInfo->arm;
+    psimInfo->arm = armDisarm;
+    psimInfo->ntriggers++;
+    psimInfo->phase += psimInfo->samples/16 + 1;
+    if(psimInfo->phase>=psimInfo->samples) psimInfo->phase = 0;
+    usrIH = psimInfo->usrIH;
+    handlerPvt = psimInfo->handlerPvt;
+    epicsMutexUnlock(psimInfo->lock);
+    if(usrIH) (*usrIH)(handlerPvt);
+}
+
+STATIC gtrStatus simreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel);
+
+/* The internal trigger fires at next, every 1/rateHz seconds, whatever
+ * else wakes the thread. If it falls behind it skips the missed triggers.
+ */
+static void simThread(void *arg)
+{
+    simInfo *psimInfo = (simInfo *)arg;
+    epicsTimeStamp next;
+    int timing = 0;
+
+    while(!isRebooting) {
+        int fire = 0;
+        gtrchannel **papgtrchannel;
+        gtrReadDone readDone;
+        void *readDonePvt;
+
+        if(psimInfo->trigger==triggerInternal && psimInfo->rateHz>0.0) {
+            double period = 1.0/psimInfo->rateHz;
+            epicsTimeStamp now;
+            double left;
+
+            epicsTimeGetCurrent(&now);
+            if(!timing) {
+                next = now;
+                epicsTimeAddSeconds(&next,period);
+                timing = 1;
+            }
+            left = epicsTimeDiffInSeconds(&next,&now);
+            if(left>0.0) {
+                epicsEventWaitWithTimeout(psimInfo->wakeup,left);
+                epicsTimeGetCurrent(&now);
+                left = epicsTimeDiffInSeconds(&next,&now);
+            }
+            if(left<=0.0) {
+                fire = 1;
+                epicsTimeAddSeconds(&next,period);
+                if(epicsTimeDiffInSeconds(&next,&now)<=0.0) {
+                    next = now;
+                    epicsTimeAddSeconds(&next,period);
+                }
+            }
+        } else {
+            timing = 0;
+            epicsEventWait(psimInfo->wakeup);
+        }
+        if(isRebooting) break;
+        epicsMutexLock(psimInfo->lock);
+        if(psimInfo->softTriggerPending) {
+            psimInfo->softTriggerPending = 0;
+            fire = 1;
+        }
+        papgtrchannel = psimInfo->papreadChannel;
+        readDone = psimInfo->readDone;
+        readDonePvt = psimInfo->readDonePvt;
+        epicsMutexUnlock(psimInfo->lock);
+        if(papgtrchannel) {
+            gtrStatus status = simreadMemory(psimInfo,papgtrchannel);
+
+            epicsMutexLock(psimInfo->lock);
+            psimInfo->papreadChannel = 0;
+            epicsMutexUnlock(psimInfo->lock);
+            (*readDone)(readDonePvt,status);
+        }
+        if(fire) simFire(psimInfo);
+    }
+}
+
+STATIC void siminit(gtrPvt pvt)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+    char name[40];
+
+    sprintf(name,"gtrSim%d",psimInfo->card);
+    psimInfo->tid = epicsThreadCreate(name,epicsThreadPriorityHigh,
+        epicsThreadGetStackSize(epicsThreadStackSmall),
+        simThread,psimInfo);
+    if(!psimInfo->tid) printf("%s: epicsThreadCreate failed\n",name);
+}
+
+STATIC void simreport(gtrPvt pvt,int level)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+
+    printf("%s card %d nchannels %d samples %d rate %g Hz\n",
+        psimInfo->name,psimInfo->card,psimInfo->nchannels,
+        psimInfo->samples,psimInfo->rateHz);
+    if(level<1) return;
+    printf("    arm %s trigger %s clock %s multiEvent %s"
+        " PTS %d PPS %d PTE %d\n",
+        armChoices[psimInfo->arm],triggerChoices[psimInfo->trigger],
+        clockChoices[psimInfo->clock],
+        multiEventChoices[psimInfo->indMultiEventNumber],
+        psimInfo->numberPTS,psimInfo->numberPPS,psimInfo->numberPTE);
+    printf("    triggers %lu reads %lu\n",psimInfo->ntriggers,psimInfo->nreads);
+}
+
+STATIC gtrStatus simclock(gtrPvt pvt, int value)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+
+    if(value<0 || value>=nclockChoices) return(gtrStatusError);
+    psimInfo->clock = value;
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simtrigger(gtrPvt pvt, int value)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+
+    if(value<0 || value>=ntriggerChoices) return(gtrStatusError);
+    psimInfo->trigger = value;
+    epicsEventSignal(psimInfo->wakeup);
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simmultiEvent(gtrPvt pvt, int value)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+
+    if(value<0 || value>=nmultiEventChoices) return(gtrStatusError);
+    psimInfo->indMultiEventNumber = value;
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simnumberPTS(gtrPvt pvt, int value)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+
+    if(value<0) return(gtrStatusError);
+    psimInfo->numberPTS = value;
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simnumberPPS(gtrPvt pvt, int value)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+
+    if(value<0) return(gtrStatusError);
+    psimInfo->numberPPS = value;
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simnumberPTE(gtrPvt pvt, int value)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+
+    if(value<0) return(gtrStatusError);
+    psimInfo->numberPTE = value;
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simarm(gtrPvt pvt, int value)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+
+    if(value<0 || value>=narmChoices) return(gtrStatusError);
+    epicsMutexLock(psimInfo->lock);
+    psimInfo->arm = value;
+    epicsMutexUnlock(psimInfo->lock);
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simsoftTrigger(gtrPvt pvt)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+
+    epicsMutexLock(psimInfo->lock);
+    psimInfo->softTriggerPending = 1;
+    epicsMutexUnlock(psimInfo->lock);
+    epicsEventSignal(psimInfo->wakeup);
+    return(gtrStatusOK);
+}
+
+/*
+ * Copy nsamples of channel signal starting at the current event phase.
+ * The table is circular so a copy may be split in two.
+ */
+static void readChannel(simInfo *psimInfo,int signal,int start,
+    gtrchannel *pgtrchannel,int nsamples)
+{
+    epicsInt16 *ptable = psimInfo->table[signal];
+    int ndata = pgtrchannel->ndata;
+
+    while(nsamples>0) {
+        int nnow = psimInfo->samples - start;
+
+        if(nnow>nsamples) nnow = nsamples;
+        if(pgtrchannel->ftvl==menuFtypeLONG) {
+            epicsInt32 *pto = (epicsInt32 *)pgtrchannel->pdata + ndata;
+            int ind;
+
+            for(ind=0; ind<nnow; ind++) pto[ind] = ptable[start + ind];
+        } else {
+            memcpy((epicsInt16 *)pgtrchannel->pdata + ndata,
+                ptable + start,nnow*sizeof(epicsInt16));
+        }
+        ndata += nnow;
+        nsamples -= nnow;
+        start = 0;
+    }
+    pgtrchannel->ndata = ndata;
+}
+
+STATIC gtrStatus simreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+    int nevents = numberEvents[psimInfo->indMultiEventNumber];
+    int eventsize = psimInfo->samples/nevents;
+    int nperEvent,phase,signal;
+    armType firedArm;
+
+    epicsMutexLock(psimInfo->lock);
+    phase = psimInfo->phase;
+    firedArm = psimInfo->firedArm;
+    psimInfo->nreads++;
+    epicsMutexUnlock(psimInfo->lock);
+    /* The sim has disarmed itself by now, so use the arm of the trigger */
+    nperEvent = (firedArm==armPrePostTrigger)
+        ? psimInfo->numberPPS : psimInfo->numberPTS;
+    if(nperEvent<=0 || nperEvent>eventsize) nperEvent = eventsize;
+    for(signal=0; signal<psimInfo->nchannels; signal++) {
+        gtrchannel *pgtrchannel = papgtrchannel[signal];
+        int indevent;
+
+        pgtrchannel->ndata = 0;
+        if(pgtrchannel->len<=0 || !pgtrchannel->pdata) continue;
+        for(indevent=0; indevent<nevents; indevent++) {
+            int nnow = pgtrchannel->len - pgtrchannel->ndata;
+
+            if(nnow>nperEvent) nnow = nperEvent;
+            if(nnow<=0) break;
+            readChannel(psimInfo,signal,
+                (phase + indevent*eventsize)%psimInfo->samples,
+                pgtrchannel,nnow);
+        }
+    }
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simstartReadMemory(gtrPvt pvt,gtrchannel **papgtrchannel,
+    gtrReadDone done,void *donePvt)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+
+    if(!psimInfo->tid) return(gtrStatusError);
+    epicsMutexLock(psimInfo->lock);
+    if(psimInfo->papreadChannel) {
+        epicsMutexUnlock(psimInfo->lock);
+        return(gtrStatusBusy);
+    }
+    psimInfo->papreadChannel = papgtrchannel;
+    psimInfo->readDone = done;
+    psimInfo->readDonePvt = donePvt;
+    epicsMutexUnlock(psimInfo->lock);
+    epicsEventSignal(psimInfo->wakeup);
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simgetLimits(gtrPvt pvt,epicsInt32 *rawLow,epicsInt32 *rawHigh)
+{
+    *rawLow = 0;
+    *rawHigh = SIMRANGE;
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simregisterHandler(gtrPvt pvt,
+     gtrhandler usrIH,void *handlerPvt)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+
+    epicsMutexLock(psimInfo->lock);
+    psimInfo->usrIH = usrIH;
+    psimInfo->handlerPvt = handlerPvt;
+    epicsMutexUnlock(psimInfo->lock);
+    return(gtrStatusOK);
+}
+
+STATIC int simnumberChannels(gtrPvt pvt)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+    return(psimInfo->nchannels);
+}
+
+STATIC gtrStatus simclockChoices(gtrPvt pvt,int *number,char ***choice)
+{
+    *number = nclockChoices;
+    *choice = clockChoices;
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simarmChoices(gtrPvt pvt,int *number,char ***choice)
+{
+    *number = narmChoices;
+    *choice = armChoices;
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simtriggerChoices(gtrPvt pvt,int *number,char ***choice)
+{
+    *number = ntriggerChoices;
+    *choice = triggerChoices;
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simmultiEventChoices(gtrPvt pvt,int *number,char ***choice)
+{
+    *number = nmultiEventChoices;
+    *choice = multiEventChoices;
+    return(gtrStatusOK);
+}
+
+STATIC gtrStatus simname(gtrPvt pvt,char *pname,int maxchars)
+{
+    simInfo *psimInfo = (simInfo *)pvt;
+    strncpy(pname,psimInfo->name,maxchars);
+    pname[maxchars-1] = 0;
+    return(gtrStatusOK);
+}
+
+static gtrops gtrSimops = {
+siminit,
+simreport,
+simclock,
+simtrigger,
+simmultiEvent,
+0, /* no preAverage */
+simnumberPTS,
+simnumberPPS,
+simnumberPTE,
+simarm,
+simsoftTrigger,
+simreadMemory,
+simgetLimits,
+simregisterHandler,
+simnumberChannels,
+simclockChoices,
+simarmChoices,
+simtriggerChoices,
+simmultiEventChoices,
+0, /* no preAverageChoices */
+simname,
+0,0,0,0,
+simstartReadMemory
+};
+
+static void simFree(simInfo *psimInfo)
+{
+    int signal;
+
+    if(psimInfo->table) {
+        for(signal=0; signal<psimInfo->nchannels; signal++)
+            free(psimInfo->table[signal]);
+        free(psimInfo->table);
+    }
+    if(psimInfo->lock) epicsMutexDestroy(psimInfo->lock);
+    if(psimInfo->wakeup) epicsEventDestroy(psimInfo->wakeup);
+    free(psimInfo->name);
+    free(psimInfo);
+}
+
+int gtrSimConfig(int card,int nchannels,int samples,double rateHz)
+{
+    gtrops *pgtrops;
+    simInfo *psimInfo;
+    char name[40];
+    int signal;
+
+    if(!simIsInited) initialize();
+    if(gtrFind(card,&pgtrops)) {
+        printf("card is already configured\n");
+        return(0);
+    }
+    if(nchannels<=0) nchannels = 8;
+    if(nchannels>SIMMAXCHANNELS) {
+        printf("gtrSimConfig: nchannels must be <= %d\n",SIMMAXCHANNELS);
+        return(0);
+    }
+    if(samples<=0) samples = 1024;
+    if(rateHz<0.0) rateHz = 0.0;
+    psimInfo = calloc(1,sizeof(simInfo));
+    if(!psimInfo) {
+        printf("gtrSimConfig: calloc failed\n");
+        return(0);
+    }
+    psimInfo->nchannels = nchannels;
+    psimInfo->table = calloc(nchannels,sizeof(epicsInt16 *));
+    if(!psimInfo->table) {
+        printf("gtrSimConfig: calloc failed\n");
+        simFree(psimInfo);
+        return(0);
+    }
+    for(signal=0; signal<nchannels; signal++) {
+        psimInfo->table[signal] = calloc(samples,sizeof(epicsInt16));
+        if(!psimInfo->table[signal]) {
+            printf("gtrSimConfig: calloc failed\n");
+            simFree(psimInfo);
+            return(0);
+        }
+    }
+    psimInfo->lock = epicsMutexCreate();
+    psimInfo->wakeup = epicsEventCreate(epicsEventEmpty);
+    if(!psimInfo->lock || !psimInfo->wakeup) {
+        printf("gtrSimConfig: semaphore create failed\n");
+        simFree(psimInfo);
+        return(0);
+    }
+    sprintf(name,"gtrSim%d",card);
+    psimInfo->name = calloc(1,strlen(name)+1);
+    if(!psimInfo->name) {
+        printf("gtrSimConfig: calloc failed\n");
+        simFree(psimInfo);
+        return(0);
+    }
+    strcpy(psimInfo->name,name);
+    psimInfo->card = card;
+    psimInfo->samples = samples;
+    psimInfo->rateHz = rateHz;
+    psimInfo->trigger = (rateHz>0.0) ? triggerInternal : triggerSoft;
+    psimInfo->numberPTS = samples;
+    psimInfo->numberPTE = 1;
+    fillTable(psimInfo);
+    ellAdd(&simList,&psimInfo->node);
+    gtrRegisterDriver(card,psimInfo->name,&gtrSimops,psimInfo);
+    return(0);
+}
+
+/*
+ * IOC shell command registration
+ */
+#include <iocsh.h>
+static const iocshArg gtrSimConfigArg0 = { "card",iocshArgInt};
+static const iocshArg gtrSimConfigArg1 = { "nchannels",iocshArgInt};
+static const iocshArg gtrSimConfigArg2 = { "samples",iocshArgInt};
+static const iocshArg gtrSimConfigArg3 = { "rateHz",iocshArgDouble};
+static const iocshArg *gtrSimConfigArgs[] = {
+    &gtrSimConfigArg0, &gtrSimConfigArg1,
+    &gtrSimConfigArg2, &gtrSimConfigArg3};
+static const iocshFuncDef gtrSimConfigFuncDef =
+                      {"gtrSimConfig",4,gtrSimConfigArgs};
+static void gtrSimConfigCallFunc(const iocshArgBuf *args)
+{
+    gtrSimConfig(args[0].ival, args[1].ival, args[2].ival, args[3].dval);
+}
+
+/*
+ * This routine is called before multitasking has started, so there's
+ * no race condition in the test/set of firstTime.
+ */
+static void
+drvGtrSimRegisterCommands(void)
+{
+    static int firstTime = 1;
+    if (firstTime) {
+        iocshRegister(&gtrSimConfigFuncDef,gtrSimConfigCallFunc);
+        firstTime = 0;
+    }
+}
+epicsExportRegistrar(drvGtrSimRegisterCommands);
@@ -0,0 +1,24 @@
+/*drvGtrSim.h */
+
+/*************************************************************************
+* Copyright (c) 2002 The University of Chicago, as Operator of Argonne
+* National Laboratory, and the Regents of the University of California, as
+* Operator of Los Alamos National Laboratory. EPICS BASE Versions 3.13.7
+* and higher are distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*************************************************************************/
+
+#ifndef drvGtrSimH
+#define drvGtrSimH
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int gtrSimConfig(int card,int nchannels,int samples,double rateHz);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*drvGtrSimH*/
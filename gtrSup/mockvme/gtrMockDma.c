@@ -0,0 +1,369 @@
+/*gtrMockDma.c */
+
+/* Host DMA engine for epicsDma. Transfers are copied with memcpy from the
+ * memory gtrMockVme gives the boards, on a thread that stands in for the
+ * bridge DMA engine. The thread holds each transfer until the configured
+ * setup time and bandwidth say it would have ended and then calls the
+ * completion callback, so the asynchronous, chained and double buffered
+ * readouts run as they do with a real bridge.
+ *
+ * A chained list pays the setup time once. The address modifier and data
+ * width are checked like a bridge would, so alignment errors in the
+ * drivers show up on the host. An abort ends the wait at once with an
+ * error, so with a low bandwidth the epicsDma timeouts can be tried.
+ */
+
+/*************************************************************************
+* Copyright (c) 2002 The University of Chicago, as Operator of Argonne
+* National Laboratory, and the Regents of the University of California, as
+* Operator of Los Alamos National Laboratory. EPICS BASE Versions 3.13.7
+* and higher are distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <epicsTypes.h>
+#include <epicsMutex.h>
+#include <epicsEvent.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsExport.h>
+
+#include "devLib.h"
+#include "epicsDma.h"
+
+#include "gtrMockDma.h"
+
+typedef struct mockDma {
+    epicsDmaCallback_t callback;
+    void               *context;
+    epicsMutexId       lock;
+    epicsEventId       startEvent;
+    epicsEventId       abortEvent;
+    int                busy;
+    int                status;    /* of the last transfer */
+    int                toVme;
+    epicsDmaDesc       single;
+    const epicsDmaDesc *pdesc;
+    int                ndesc;
+    unsigned long      nstart;
+    unsigned long      ndesctotal;
+    unsigned long      nerror;
+    unsigned long      nabort;
+    double             nbytes;
+    double             busySeconds;
+} mockDma;
+
+static double secondsPerByte[epicsDma2eSST + 1];
+static double setupSeconds;
+static mockDma *pmockDma;
+
+/* The mode the address modifier and data width select, 0 if not valid */
+static int transferMode(const epicsDmaDesc *pdesc)
+{
+    switch(pdesc->dataWidth) {
+    case 4:
+        return(epicsDmaBLT32);
+    case 8:
+        if(pdesc->adrsSpace==epicsDmaAmA32Mblt) return(epicsDmaMBLT64);
+        if(pdesc->adrsSpace==epicsDmaAmA32_2eSST) return(epicsDma2eSST);
+        return(0);
+    }
+    return(0);
+}
+
+/* Where the VME addresses [vmeAddr,vmeAddr+length) are, NULL if they are
+ * not all in one board window
+ */
+static char *localAddr(const epicsDmaDesc *pdesc)
+{
+    epicsAddressType type;
+    volatile void *pfirst;
+    volatile void *plast;
+
+    if((pdesc->adrsSpace & 0x38)==0x38) type = atVMEA24;
+    else if((pdesc->adrsSpace & 0x38)==0x28) type = atVMEA16;
+    else type = atVMEA32;
+    if(devBusToLocalAddr(type,pdesc->vmeAddr,&pfirst)) return(0);
+    if(devBusToLocalAddr(type,pdesc->vmeAddr + pdesc->length - 1,&plast))
+        return(0);
+    if((char *)plast - (char *)pfirst!=pdesc->length - 1) return(0);
+    return((char *)pfirst);
+}
+
+/* Copy one transfer. Returns the bus time it would take, -1 on error */
+static double transfer(mockDma *pdma,const epicsDmaDesc *pdesc)
+{
+    int mode = transferMode(pdesc);
+    char *pvme;
+
+    if(!mode || pdesc->length<=0
+    || (pdesc->length % pdesc->dataWidth)
+    || (pdesc->vmeAddr % pdesc->dataWidth)
+    || ((size_t)pdesc->pLocal % pdesc->dataWidth)) return(-1.0);
+    pvme = localAddr(pdesc);
+    if(!pvme) return(-1.0);
+    if(pdma->toVme) memcpy(pvme,pdesc->pLocal,pdesc->length);
+    else memcpy(pdesc->pLocal,pvme,pdesc->length);
+    pdma->nbytes += pdesc->length;
+    return(pdesc->length*secondsPerByte[mode]);
+}
+
+/* Wait until seconds have passed since start. Returns -1 if aborted */
+static int waitUntil(mockDma *pdma,const epicsTimeStamp *pstart,
+    double seconds)
+{
+    double quantum = epicsThreadSleepQuantum();
+
+    while(1) {
+        epicsTimeStamp now;
+        double left;
+
+        epicsTimeGetCurrent(&now);
+        left = seconds - epicsTimeDiffInSeconds(&now,pstart);
+        if(left<=0.0) return(0);
+        if(left>2.0*quantum) {
+            if(epicsEventWaitWithTimeout(pdma->abortEvent,left - quantum)
+                ==epicsEventWaitOK) return(-1);
+        } else if(epicsEventTryWait(pdma->abortEvent)==epicsEventWaitOK) {
+            return(-1);
+        }
+    }
+}
+
+static void dmaThread(void *arg)
+{
+    mockDma *pdma = (mockDma *)arg;
+
+    while(1) {
+        epicsTimeStamp start;
+        double seconds = setupSeconds;
+        int status = 0;
+        int ind;
+
+        epicsEventMustWait(pdma->startEvent);
+        /* An abort that came after the last transfer ended */
+        epicsEventTryWait(pdma->abortEvent);
+        epicsTimeGetCurrent(&start);
+        for(ind=0; ind<pdma->ndesc; ind++) {
+            double busSeconds = transfer(pdma,&pdma->pdesc[ind]);
+
+            if(busSeconds<0.0) {
+                pdma->nerror++;
+                status = -1;
+                break;
+            }
+            seconds += busSeconds;
+        }
+        if(waitUntil(pdma,&start,seconds)) {
+            epicsTimeStamp now;
+
+            epicsTimeGetCurrent(&now);
+            seconds = epicsTimeDiffInSeconds(&now,&start);
+            pdma->nabort++;
+            status = -1;
+        }
+        epicsMutexMustLock(pdma->lock);
+        pdma->busySeconds += seconds;
+        pdma->status = status;
+        pdma->busy = 0;
+        epicsMutexUnlock(pdma->lock);
+        if(pdma->callback) (*pdma->callback)(pdma->context);
+    }
+}
+
+/* Hand pdesc to the thread. Fails if a transfer is running */
+static int start(mockDma *pdma,const epicsDmaDesc *pdesc,int ndesc,int toVme)
+{
+    epicsMutexMustLock(pdma->lock);
+    if(pdma->busy) {
+        epicsMutexUnlock(pdma->lock);
+        return(-1);
+    }
+    pdma->busy = 1;
+    pdma->toVme = toVme;
+    if(ndesc==1) {
+        pdma->single = *pdesc;
+        pdesc = &pdma->single;
+    }
+    pdma->pdesc = pdesc;
+    pdma->ndesc = ndesc;
+    pdma->nstart++;
+    pdma->ndesctotal += ndesc;
+    epicsMutexUnlock(pdma->lock);
+    epicsEventSignal(pdma->startEvent);
+    return(0);
+}
+
+/*
+ * epicsDmaBackend
+ */
+static void *mockCreate(epicsDmaCallback_t callback,void *context)
+{
+    mockDma *pdma = calloc(1,sizeof(mockDma));
+
+    if(!pdma) {
+        printf("gtrMockDma: calloc failed\n");
+        return(0);
+    }
+    pdma->callback = callback;
+    pdma->context = context;
+    pdma->lock = epicsMutexMustCreate();
+    pdma->startEvent = epicsEventMustCreate(epicsEventEmpty);
+    pdma->abortEvent = epicsEventMustCreate(epicsEventEmpty);
+    if(!epicsThreadCreate("gtrMockDma",epicsThreadPriorityHigh,
+        epicsThreadGetStackSize(epicsThreadStackSmall),dmaThread,pdma)) {
+        printf("gtrMockDma: epicsThreadCreate failed\n");
+        return(0);
+    }
+    pmockDma = pdma;
+    return(pdma);
+}
+
+static int mockStatus(void *id)
+{
+    return(((mockDma *)id)->status);
+}
+
+static int mockToVme(void *id,epicsUInt32 vmeAddr,int adrsSpace,
+    void *pLocal,int length,int dataWidth)
+{
+    epicsDmaDesc desc;
+
+    desc.pLocal = pLocal;
+    desc.vmeAddr = vmeAddr;
+    desc.adrsSpace = adrsSpace;
+    desc.length = length;
+    desc.dataWidth = dataWidth;
+    return(start((mockDma *)id,&desc,1,1));
+}
+
+static int mockFromVme(void *id,void *pLocal,epicsUInt32 vmeAddr,
+    int adrsSpace,int length,int dataWidth)
+{
+    epicsDmaDesc desc;
+
+    desc.pLocal = pLocal;
+    desc.vmeAddr = vmeAddr;
+    desc.adrsSpace = adrsSpace;
+    desc.length = length;
+    desc.dataWidth = dataWidth;
+    return(start((mockDma *)id,&desc,1,0));
+}
+
+static int mockModes(void)
+{
+    return(epicsDmaModeMask(epicsDmaBLT32) | epicsDmaModeMask(epicsDmaMBLT64)
+        | epicsDmaModeMask(epicsDma2eSST));
+}
+
+static int mockListFromVme(void *id,const epicsDmaDesc *pdesc,int ndesc)
+{
+    return(start((mockDma *)id,pdesc,ndesc,0));
+}
+
+static int mockAbort(void *id)
+{
+    mockDma *pdma = (mockDma *)id;
+
+    epicsMutexMustLock(pdma->lock);
+    if(pdma->busy) epicsEventSignal(pdma->abortEvent);
+    epicsMutexUnlock(pdma->lock);
+    return(0);
+}
+
+static const epicsDmaBackend mockBackend = {
+    "gtrMockDma",
+    mockCreate,
+    mockStatus,
+    mockToVme,
+    mockFromVme,
+    mockModes,
+    mockListFromVme,
+    mockAbort
+};
+
+static double perByte(double mbps)
+{
+    return((mbps>0.0) ? 1.0/(mbps*1e6) : 0.0);
+}
+
+int gtrMockDmaConfig(double bltMBps,double mbltMBps,double sstMBps,
+    double setupUsec)
+{
+    if(bltMBps<0.0 || mbltMBps<0.0 || sstMBps<0.0 || setupUsec<0.0) {
+        printf("gtrMockDmaConfig: arguments must not be negative\n");
+        return(-1);
+    }
+    secondsPerByte[epicsDmaBLT32] = perByte(bltMBps);
+    secondsPerByte[epicsDmaMBLT64] = perByte(mbltMBps);
+    secondsPerByte[epicsDma2eSST] = perByte(sstMBps);
+    setupSeconds = setupUsec*1e-6;
+    if(epicsDmaRegister(&mockBackend)) {
+        printf("gtrMockDmaConfig: epicsDmaRegister failed\n");
+        return(-1);
+    }
+    return(0);
+}
+
+void gtrMockDmaReport(int level)
+{
+    mockDma *pdma = pmockDma;
+    int mode;
+
+    printf("gtrMockDma setup %.1f usec",setupSeconds*1e6);
+    for(mode=epicsDmaBLT32; mode<=epicsDma2eSST; mode++) {
+        if(secondsPerByte[mode]>0.0)
+            printf(" %.1f",1e-6/secondsPerByte[mode]);
+        else
+            printf(" memcpy");
+    }
+    printf(" MB/s\n");
+    if(!pdma) return;
+    printf("    starts %lu transfers %lu errors %lu aborts %lu"
+        " MB %.1f busy %.3f sec\n",
+        pdma->nstart,pdma->ndesctotal,pdma->nerror,pdma->nabort,
+        pdma->nbytes*1e-6,pdma->busySeconds);
+}
+
+/*
+ * IOC shell command registration
+ */
+#include <iocsh.h>
+static const iocshArg gtrMockDmaConfigArg0 = { "BLT32 MB/s",iocshArgDouble};
+static const iocshArg gtrMockDmaConfigArg1 = { "MBLT64 MB/s",iocshArgDouble};
+static const iocshArg gtrMockDmaConfigArg2 = { "2eSST MB/s",iocshArgDouble};
+static const iocshArg gtrMockDmaConfigArg3 = { "setup usec",iocshArgDouble};
+static const iocshArg *gtrMockDmaConfigArgs[] = {
+    &gtrMockDmaConfigArg0, &gtrMockDmaConfigArg1, &gtrMockDmaConfigArg2,
+    &gtrMockDmaConfigArg3};
+static const iocshFuncDef gtrMockDmaConfigFuncDef =
+                      {"gtrMockDmaConfig",4,gtrMockDmaConfigArgs};
+static void gtrMockDmaConfigCallFunc(const iocshArgBuf *args)
+{
+    gtrMockDmaConfig(args[0].dval, args[1].dval, args[2].dval, args[3].dval);
+}
+
+static const iocshArg gtrMockDmaReportArg0 = { "level",iocshArgInt};
+static const iocshArg *gtrMockDmaReportArgs[] = {&gtrMockDmaReportArg0};
+static const iocshFuncDef gtrMockDmaReportFuncDef =
+                      {"gtrMockDmaReport",1,gtrMockDmaReportArgs};
+static void gtrMockDmaReportCallFunc(const iocshArgBuf *args)
+{
+    gtrMockDmaReport(args[0].ival);
+}
+
+static void
+gtrMockDmaRegisterCommands(void)
+{
+    static int firstTime = 1;
+    if (firstTime) {
+        iocshRegister(&gtrMockDmaConfigFuncDef,gtrMockDmaConfigCallFunc);
+        iocshRegister(&gtrMockDmaReportFuncDef,gtrMockDmaReportCallFunc);
+        firstTime = 0;
+    }
+}
+epicsExportRegistrar(gtrMockDmaRegisterCommands);
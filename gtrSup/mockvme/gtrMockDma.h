@@ -0,0 +1,37 @@
+/*gtrMockDma.h */
+
+/*************************************************************************
+* Copyright (c) 2002 The University of Chicago, as Operator of Argonne
+* National Laboratory, and the Regents of the University of California, as
+* Operator of Los Alamos National Laboratory. EPICS BASE Versions 3.13.7
+* and higher are distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*************************************************************************/
+
+#ifndef gtrMockDmaH
+#define gtrMockDmaH
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Registers the epicsDma backend "gtrMockDma", a host DMA engine that
+ * copies from the gtrMockVme boards with memcpy on a thread of its own and
+ * then calls the completion callback, as a bridge interrupt would. On a
+ * host without other backends it is the default. Must precede the driver
+ * Config commands that use it.
+ *
+ * bltMBps, mbltMBps and sstMBps are the bandwidth in MB/s of BLT32 (and
+ * single cycles), MBLT64 and 2eSST. 0 means as fast as memcpy.
+ * setupUsec is the time it takes to start a transfer or a chained list.
+ */
+int gtrMockDmaConfig(double bltMBps,double mbltMBps,double sstMBps,
+    double setupUsec);
+
+void gtrMockDmaReport(int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*gtrMockDmaH*/
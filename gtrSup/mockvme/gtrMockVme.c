@@ -0,0 +1,807 @@
+/*gtrMockVme.c */
+
+/* Host memory stand-in for the devLib VME calls made by the TR drivers.
+ * Each configured board gets an A16 register window and an A32 memory
+ * window in ordinary host memory. The ID registers are preloaded and the
+ * memory is filled with synthetic packed samples so that the unmodified
+ * drivers can be run, benchmarked and tested on a host without VME.
+ *
+ * A trigger sets the registers the driver reads after an interrupt
+ * (trigger directory, memory location counters, event counters) and
+ * then calls the interrupt handler the driver connected to its vector.
+ * Soft trigger register writes are picked up by a polling thread.
+ */
+
+/*************************************************************************
+* Copyright (c) 2002 The University of Chicago, as Operator of Argonne
+* National Laboratory, and the Regents of the University of California, as
+* Operator of Los Alamos National Laboratory. EPICS BASE Versions 3.13.7
+* and higher are distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <epicsTypes.h>
+#include <epicsMutex.h>
+#include <epicsThread.h>
+#include <epicsExport.h>
+
+#include "ellLib.h"
+#include "devLib.h"
+#include "devLibImpl.h"
+
+#include "gtrMockVme.h"
+
+#define STATIC static
+
+#define A16SIZE     0x100
+#define NVECTORS    256
+#define NLEVELS     8
+#define SINESIZE    1024
+#define POLLSECONDS 0.01
+
+typedef unsigned int uint32;
+typedef unsigned short uint16;
+typedef unsigned char uint8;
+
+typedef enum {
+    mockSis3300,mockSis3301,
+    mockVtr10012,mockVtr10012_8,mockVtr8014,mockVtr10014,
+    mockVtr812,mockVtr812_40,
+    mockVtr1012,mockVtr10010
+} mockType;
+#define mockNTypes mockVtr10010 + 1
+static const char *mockTypeName[mockNTypes] = {
+    "sis3300","sis3301",
+    "vtr10012","vtr10012_8","vtr8014","vtr10014",
+    "vtr812","vtr812_40",
+    "vtr1012","vtr10010"
+};
+
+typedef struct mockBoard {
+    ELLNODE     node;
+    mockType    type;
+    int         intVec;
+    int         a16offset;
+    char        *a16;
+    unsigned int a32offset;
+    char        *a32;
+    size_t      a32size;
+    int         samples;    /* samples per channel */
+    int         eventCount; /* triggers since the board was last armed */
+    unsigned long ntriggers;
+    unsigned long nspurious;
+} mockBoard;
+
+typedef struct mockVector {
+    void (*pfunction)(void *);
+    void *parameter;
+} mockVector;
+
+static ELLLIST boardList;
+static epicsMutexId mockLock;
+static epicsThreadId pollTid;
+static mockVector vectorTable[NVECTORS];
+static int levelEnabled[NLEVELS];
+static double sineTable[SINESIZE];
+static int mockIsInited = 0;
+
+/*
+ * Synthetic data. Channel n is a sine with n+1 cycles per SINESIZE
+ * samples centered in the ADC range.
+ */
+static uint16 sampleValue(int signal,int ind,uint16 mask)
+{
+    double mid = (mask + 1)/2.0;
+    double value = mid + 0.4*mid*sineTable[((signal + 1)*ind)&(SINESIZE - 1)];
+
+    return(((uint16)value)&mask);
+}
+
+static void fillPacked(uint32 *pgroup,int nwords,
+    int signalHigh,int signalLow,uint16 mask)
+{
+    int ind;
+
+    for(ind=0; ind<nwords; ind++) {
+        pgroup[ind] = ((uint32)sampleValue(signalHigh,ind,mask)<<16)
+                    | sampleValue(signalLow,ind,mask);
+    }
+}
+
+static void fillInt16(epicsInt16 *pchannel,int nsamples,int signal,uint16 mask)
+{
+    int ind;
+
+    for(ind=0; ind<nsamples; ind++)
+        pchannel[ind] = sampleValue(signal,ind,mask);
+}
+
+/* Register access helpers. Offsets are the ones used by the drivers. */
+static uint32 get32(char *base,int offset)
+{ return(*(volatile uint32 *)(base + offset)); }
+static void put32(char *base,int offset,uint32 value)
+{ *(volatile uint32 *)(base + offset) = value; }
+static uint16 get16(char *base,int offset)
+{ return(*(volatile uint16 *)(base + offset)); }
+static void put16(char *base,int offset,uint16 value)
+{ *(volatile uint16 *)(base + offset) = value; }
+static uint8 get8(char *base,int offset)
+{ return(*(volatile uint8 *)(base + offset)); }
+static void put8(char *base,int offset,uint8 value)
+{ *(volatile uint8 *)(base + offset) = value; }
+
+static uint32 get24(char *base,int high,int middle,int low)
+{
+    return(get8(base,high)<<16 | get8(base,middle)<<8 | get8(base,low));
+}
+
+static void put24(char *base,int high,int middle,int low,uint32 value)
+{
+    put8(base,high,(value>>16)&0xff);
+    put8(base,middle,(value>>8)&0xff);
+    put8(base,low,value&0xff);
+}
+
+/*
+ * SIS3300/3301
+ * All registers are in the A32 window. Each of the 4 groups is a bank of
+ * 0x20000 words at MEMORYSTART + group*0x80000 holding signals 2g and 2g+1.
+ */
+#define SIS_MODID       0x00000004
+#define SIS_STOPDELAY   0x00000018
+#define SIS_START       0x00000030
+#define SIS_EVENTCONFIG 0x00100000
+#define SIS_TRIGGEREVENTDIRECTORY 0x00101000
+#define SIS_BANK1ADDRESS 0x00200008
+#define SIS_EVENTCOUNTER 0x00200010
+#define SIS_EVENTDIRECTORY 0x00201000
+#define SIS_MEMORYSTART 0x00400000
+#define SIS_GROUPBYTES  0x00080000
+#define SIS_ARRAYSIZE   (SIS_GROUPBYTES/4)
+
+static int sisEvents[8] = {1,8,32,64,128,256,512,1024};
+
+static void sisSetup(mockBoard *pboard)
+{
+    uint16 mask = (pboard->type==mockSis3300) ? 0x0fff : 0x3fff;
+    int group;
+
+    put32(pboard->a32,SIS_MODID,
+        (pboard->type==mockSis3300) ? 0x33000000 : 0x33010000);
+    for(group=0; group<4; group++) {
+        fillPacked((uint32 *)(pboard->a32 + SIS_MEMORYSTART
+            + group*SIS_GROUPBYTES),SIS_ARRAYSIZE,2*group,2*group + 1,mask);
+    }
+    pboard->samples = SIS_ARRAYSIZE;
+}
+
+static void sisTrigger(mockBoard *pboard,int location)
+{
+    char *a32 = pboard->a32;
+    int nevents = sisEvents[get32(a32,SIS_EVENTCONFIG)&0x7];
+    int eventsize = SIS_ARRAYSIZE/nevents;
+    uint32 stopDelay = get32(a32,SIS_STOPDELAY);
+    int indevent;
+
+    if(location<0) location = eventsize/2;
+    location %= eventsize;
+    for(indevent=0; indevent<nevents; indevent++) {
+        put32(a32,SIS_EVENTDIRECTORY + indevent*4,location);
+        put32(a32,SIS_TRIGGEREVENTDIRECTORY + indevent*4,
+            (stopDelay>=(uint32)eventsize) ? (1<<19) : stopDelay);
+    }
+    put32(a32,SIS_EVENTCOUNTER,nevents);
+    put32(a32,SIS_BANK1ADDRESS,
+        (stopDelay>=(uint32)eventsize) ? eventsize : stopDelay);
+}
+
+static int sisSoftTrigger(mockBoard *pboard)
+{
+    if(!get32(pboard->a32,SIS_START)) return(0);
+    put32(pboard->a32,SIS_START,0);
+    return(1);
+}
+
+/*
+ * VTR10012, VTR10012_8, VTR8014 and VTR10014
+ * 16 bit registers in A16. Group g is at g*0x400000 in A32 and holds
+ * signal g+4 in the high half and signal g in the low half of each word.
+ */
+#define V10012_ID       0x0C
+#define V10012_MULPREPOST 0x0E
+#define V10012_TRIGGER  0x10
+#define V10012_ARMR     0x12
+#define V10012_HGDR     0x20
+#define V10012_LGDR     0x22
+#define V10012_HMLC     0x24
+#define V10012_LMLC     0x26
+#define V10012_CPTCCDARM 0x30
+#define V10012_CPTCC    0x32
+#define V10012_TCOUNTER 0x34
+#define V10012_GROUPBYTES 0x00400000
+
+static void vtr10012Setup(mockBoard *pboard)
+{
+    static const uint16 idCode[4] = {7,8,9,10};
+    int model = pboard->type - mockVtr10012;
+    uint16 mask = (pboard->type==mockVtr8014 || pboard->type==mockVtr10014)
+        ? 0x3fff : 0x0fff;
+    int group;
+
+    if(pboard->samples<=0) pboard->samples = 256*1024;
+    if(pboard->samples>V10012_GROUPBYTES/4)
+        pboard->samples = V10012_GROUPBYTES/4;
+    put16(pboard->a16,V10012_ID,idCode[model]<<10);
+    for(group=0; group<4; group++) {
+        fillPacked((uint32 *)(pboard->a32 + group*V10012_GROUPBYTES),
+            pboard->samples,group + 4,group,mask);
+    }
+}
+
+static void vtr10012Trigger(mockBoard *pboard,int location)
+{
+    char *a16 = pboard->a16;
+    uint32 gate,stored;
+
+    if(get16(a16,V10012_ARMR)) {
+        put16(a16,V10012_ARMR,0);
+        pboard->eventCount = 0;
+    }
+    pboard->eventCount++;
+    put16(a16,V10012_CPTCC,pboard->eventCount);
+    put16(a16,V10012_CPTCCDARM,pboard->eventCount);
+    gate = get16(a16,V10012_HGDR)<<16 | get16(a16,V10012_LGDR);
+    stored = gate*pboard->eventCount;
+    if(stored>(uint32)pboard->samples) stored = pboard->samples;
+    put16(a16,V10012_HMLC,(stored>>16)&0xffff);
+    put16(a16,V10012_LMLC,stored&0xffff);
+    /* Both halves of the trigger counter are read from one address,
+     * which host memory can only model for location 0 */
+    put16(a16,V10012_TCOUNTER,0);
+}
+
+static int vtr10012SoftTrigger(mockBoard *pboard)
+{
+    if(!get16(pboard->a16,V10012_TRIGGER)) return(0);
+    put16(pboard->a16,V10012_TRIGGER,0);
+    return(1);
+}
+
+/*
+ * VTR812/10 and VTR812/40
+ * 8 bit registers at odd A16 addresses, same memory layout as VTR10012.
+ */
+#define V812_IRQLEVEL   0x0B
+#define V812_ID         0x0F
+#define V812_CSR2       0x23
+#define V812_DISARM     0x25
+#define V812_SOFTTRIGGER 0x2D
+#define V812_LBMLC      0x31
+#define V812_MBMLC      0x33
+#define V812_HBMLC      0x35
+#define V812_LBPMEMS    0x37
+#define V812_MBPMEMS    0x39
+#define V812_HBPMEMS    0x3B
+#define V812_PMEMCOUNTER 0x3D
+#define V812_MULTIPREPOST 0x3F
+#define V812_GROUPBYTES 0x00400000
+
+static void vtr812Setup(mockBoard *pboard)
+{
+    int memIndex;
+    int group;
+
+    if(pboard->samples<=0) pboard->samples = 128*1024;
+    /* memory size codes 0..3 are 128K..1M samples, larger does not fit */
+    for(memIndex=0; memIndex<3; memIndex++) {
+        if((128*1024<<memIndex)>=pboard->samples) break;
+    }
+    pboard->samples = 128*1024<<memIndex;
+    put8(pboard->a16,V812_ID,
+        ((pboard->type==mockVtr812) ? 5 : 6) | (memIndex<<3));
+    put8(pboard->a16,V812_IRQLEVEL,3);
+    for(group=0; group<4; group++) {
+        fillPacked((uint32 *)(pboard->a32 + group*V812_GROUPBYTES),
+            pboard->samples,group + 4,group,0x0fff);
+    }
+}
+
+/* The driver writes Disarm on every arm request and in its handler */
+static void vtr812Disarm(mockBoard *pboard)
+{
+    char *a16 = pboard->a16;
+
+    if(!get8(a16,V812_DISARM)) return;
+    put8(a16,V812_DISARM,0);
+    put8(a16,V812_CSR2,get8(a16,V812_CSR2) & ~0x40);
+    pboard->eventCount = 0;
+}
+
+static void vtr812Trigger(mockBoard *pboard,int location)
+{
+    char *a16 = pboard->a16;
+    uint8 multi = get8(a16,V812_MULTIPREPOST);
+    int nevents = (multi&0x04) ? 2<<(multi&0x03) : 1;
+    int eventsize = pboard->samples/nevents;
+
+    vtr812Disarm(pboard);
+    pboard->eventCount++;
+    if(location<0) location = eventsize/2;
+    location %= eventsize;
+    put8(a16,V812_PMEMCOUNTER,pboard->eventCount);
+    put24(a16,V812_HBMLC,V812_MBMLC,V812_LBMLC,location);
+    /* One address per byte, so only the first event location is modeled */
+    put24(a16,V812_HBPMEMS,V812_MBPMEMS,V812_LBPMEMS,location);
+}
+
+static int vtr812SoftTrigger(mockBoard *pboard)
+{
+    vtr812Disarm(pboard);
+    if(!get8(pboard->a16,V812_SOFTTRIGGER)) return(0);
+    put8(pboard->a16,V812_SOFTTRIGGER,0);
+    return(1);
+}
+
+/*
+ * VTR1012 (4 channels) and VTR10010 (1 channel)
+ * 8 bit registers in A16, one epicsInt16 array per channel in A32.
+ */
+#define V1012_CSR1BYTE1 0x01
+#define V1012_MBMLR     0x02
+#define V1012_LBMLR     0x03
+#define V1012_MBGDR     0x04
+#define V1012_LBGDR     0x05
+#define V1012_HBMLR     0x09
+#define V1012_HBGDR     0x0B
+#define V1012_IACKLEV   0x0F
+#define V1012_IDREG     0x13
+
+static int vtr1012MemorySize[7] =
+{0x20000,0x40000,0x80000,0x100000,0x200000,0x400000,0x800000};
+
+static int vtr1012Channels(mockBoard *pboard)
+{
+    return((pboard->type==mockVtr1012) ? 4 : 1);
+}
+
+static void vtr1012Setup(mockBoard *pboard)
+{
+    uint16 mask = (pboard->type==mockVtr1012) ? 0x0fff : 0x03ff;
+    int id,signal;
+
+    for(id=0; id<6; id++) {
+        if(vtr1012MemorySize[id]>=pboard->samples) break;
+    }
+    /* The vtr10010 driver sizes its array from IDREG */
+    if(pboard->type==mockVtr10010 || pboard->samples<=0)
+        pboard->samples = vtr1012MemorySize[id];
+    put8(pboard->a16,V1012_IDREG,id<<3);
+    put8(pboard->a16,V1012_IACKLEV,3);
+    for(signal=0; signal<vtr1012Channels(pboard); signal++) {
+        fillInt16((epicsInt16 *)pboard->a32 + signal*pboard->samples,
+            pboard->samples,signal,mask);
+    }
+}
+
+static void vtr1012Trigger(mockBoard *pboard,int location)
+{
+    char *a16 = pboard->a16;
+    uint8 csr1byte0 = get8(a16,0x00);
+
+    if(csr1byte0&0x10) { /*circular buffer, i.e. prePostTrigger*/
+        if(location<0) location = pboard->samples/2;
+        location %= pboard->samples;
+    } else {
+        uint32 gate = get24(a16,V1012_HBGDR,V1012_MBGDR,V1012_LBGDR);
+
+        location = get24(a16,V1012_HBMLR,V1012_MBMLR,V1012_LBMLR) + gate;
+        if(location>pboard->samples) location = pboard->samples;
+    }
+    put24(a16,V1012_HBMLR,V1012_MBMLR,V1012_LBMLR,location);
+}
+
+static int vtr1012SoftTrigger(mockBoard *pboard)
+{
+    uint8 csr1byte1 = get8(pboard->a16,V1012_CSR1BYTE1);
+
+    if(!(csr1byte1&0x80)) return(0);
+    put8(pboard->a16,V1012_CSR1BYTE1,csr1byte1&0x7f);
+    return(1);
+}
+
+static void boardTrigger(mockBoard *pboard,int location)
+{
+    mockVector *pvector;
+
+    switch(pboard->type) {
+    case mockSis3300: case mockSis3301:
+        sisTrigger(pboard,location); break;
+    case mockVtr10012: case mockVtr10012_8:
+    case mockVtr8014: case mockVtr10014:
+        vtr10012Trigger(pboard,location); break;
+    case mockVtr812: case mockVtr812_40:
+        vtr812Trigger(pboard,location); break;
+    case mockVtr1012: case mockVtr10010:
+        vtr1012Trigger(pboard,location); break;
+    }
+    pboard->ntriggers++;
+    pvector = &vectorTable[pboard->intVec&(NVECTORS - 1)];
+    if(pvector->pfunction) {
+        (*pvector->pfunction)(pvector->parameter);
+    } else {
+        pboard->nspurious++;
+    }
+}
+
+static int boardSoftTrigger(mockBoard *pboard)
+{
+    switch(pboard->type) {
+    case mockSis3300: case mockSis3301:
+        return(sisSoftTrigger(pboard));
+    case mockVtr10012: case mockVtr10012_8:
+    case mockVtr8014: case mockVtr10014:
+        return(vtr10012SoftTrigger(pboard));
+    case mockVtr812: case mockVtr812_40:
+        return(vtr812SoftTrigger(pboard));
+    case mockVtr1012: case mockVtr10010:
+        return(vtr1012SoftTrigger(pboard));
+    }
+    return(0);
+}
+
+static void pollThread(void *arg)
+{
+    while(1) {
+        mockBoard *pboard;
+
+        epicsThreadSleep(POLLSECONDS);
+        epicsMutexLock(mockLock);
+        pboard = (mockBoard *)ellFirst(&boardList);
+        while(pboard) {
+            if(boardSoftTrigger(pboard)) boardTrigger(pboard,-1);
+            pboard = (mockBoard *)ellNext(&pboard->node);
+        }
+        epicsMutexUnlock(mockLock);
+    }
+}
+
+/*
+ * devLib virtual OS interface
+ */
+static int inWindow(char *base,size_t size,volatile const void *ptr,
+    unsigned wordSize)
+{
+    const char *p = (const char *)ptr;
+
+    return(base && p>=base && p+wordSize<=base+size);
+}
+
+static mockBoard *findLocal(volatile const void *ptr,unsigned wordSize)
+{
+    mockBoard *pboard = (mockBoard *)ellFirst(&boardList);
+
+    while(pboard) {
+        if(inWindow(pboard->a16,A16SIZE,ptr,wordSize)
+        || inWindow(pboard->a32,pboard->a32size,ptr,wordSize)) break;
+        pboard = (mockBoard *)ellNext(&pboard->node);
+    }
+    return(pboard);
+}
+
+STATIC long mockMapAddr(epicsAddressType addrType,unsigned options,
+    size_t logicalAddress,size_t size,volatile void **ppPhysicalAddress)
+{
+    mockBoard *pboard = (mockBoard *)ellFirst(&boardList);
+
+    /* VME addresses are 32 bits. Some drivers keep them in an int, which
+     * sign extends on a 64 bit host */
+    logicalAddress = (epicsUInt32)logicalAddress;
+    while(pboard) {
+        if(addrType==atVMEA16 && pboard->a16
+        && logicalAddress>=(size_t)pboard->a16offset
+        && logicalAddress+size<=(size_t)pboard->a16offset+A16SIZE) {
+            *ppPhysicalAddress = pboard->a16
+                + (logicalAddress - pboard->a16offset);
+            return(0);
+        }
+        if(addrType==atVMEA32 && pboard->a32
+        && logicalAddress>=(size_t)pboard->a32offset
+        && logicalAddress+size<=(size_t)pboard->a32offset+pboard->a32size) {
+            *ppPhysicalAddress = pboard->a32
+                + (logicalAddress - pboard->a32offset);
+            return(0);
+        }
+        pboard = (mockBoard *)ellNext(&pboard->node);
+    }
+    return(S_dev_addressNotFound);
+}
+
+STATIC long mockReadProbe(unsigned wordSize,volatile const void *ptr,
+    void *pValueRead)
+{
+    if(!findLocal(ptr,wordSize)) return(S_dev_noDevice);
+    memcpy(pValueRead,(const void *)ptr,wordSize);
+    return(0);
+}
+
+STATIC long mockWriteProbe(unsigned wordSize,volatile void *ptr,
+    const void *pValueWritten)
+{
+    if(!findLocal(ptr,wordSize)) return(S_dev_noDevice);
+    memcpy((void *)ptr,pValueWritten,wordSize);
+    return(0);
+}
+
+STATIC long mockConnectInterruptVME(unsigned vectorNumber,
+    void (*pFunction)(void *),void *parameter)
+{
+    if(vectorNumber>=NVECTORS) return(S_dev_badVector);
+    if(vectorTable[vectorNumber].pfunction) return(S_dev_vectorInUse);
+    vectorTable[vectorNumber].parameter = parameter;
+    vectorTable[vectorNumber].pfunction = pFunction;
+    return(0);
+}
+
+STATIC long mockDisconnectInterruptVME(unsigned vectorNumber,
+    void (*pFunction)(void *))
+{
+    if(vectorNumber>=NVECTORS) return(S_dev_badVector);
+    if(vectorTable[vectorNumber].pfunction!=pFunction)
+        return(S_dev_vectorNotInUse);
+    vectorTable[vectorNumber].pfunction = 0;
+    vectorTable[vectorNumber].parameter = 0;
+    return(0);
+}
+
+STATIC long mockEnableInterruptLevelVME(unsigned level)
+{
+    if(level>=NLEVELS) return(S_dev_badArgument);
+    levelEnabled[level] = 1;
+    return(0);
+}
+
+STATIC long mockDisableInterruptLevelVME(unsigned level)
+{
+    if(level>=NLEVELS) return(S_dev_badArgument);
+    levelEnabled[level] = 0;
+    return(0);
+}
+
+STATIC void *mockA24Malloc(size_t nbytes)
+{
+    return(calloc(1,nbytes));
+}
+
+STATIC void mockA24Free(void *pBlock)
+{
+    free(pBlock);
+}
+
+STATIC long mockInit(void)
+{
+    return(0);
+}
+
+STATIC int mockInterruptInUseVME(unsigned vectorNumber)
+{
+    if(vectorNumber>=NVECTORS) return(0);
+    return(vectorTable[vectorNumber].pfunction ? 1 : 0);
+}
+
+static devLibVirtualOS mockVirtualOS = {
+mockMapAddr,
+mockReadProbe,
+mockWriteProbe,
+mockConnectInterruptVME,
+mockDisconnectInterruptVME,
+mockEnableInterruptLevelVME,
+mockDisableInterruptLevelVME,
+mockA24Malloc,
+mockA24Free,
+mockInit,
+mockInterruptInUseVME
+};
+
+/*
+ * vxWorks and RTEMS BSPs supply bcopyLongs, the host does not
+ */
+void bcopyLongs(char *source,char *destination,int nlongs)
+{
+    memcpy(destination,source,nlongs*sizeof(epicsUInt32));
+}
+
+void gtrMockVmeInstall(void)
+{
+    int ind;
+
+    if(mockIsInited) return;
+    mockIsInited = 1;
+    ellInit(&boardList);
+    mockLock = epicsMutexCreate();
+    for(ind=0; ind<SINESIZE; ind++)
+        sineTable[ind] = sin(2.0*M_PI*ind/SINESIZE);
+    pdevLibVirtualOS = &mockVirtualOS;
+}
+
+int gtrMockVmeConfig(const char *typeName,int a16offset,
+    unsigned int a32offset,int intVec,int samples)
+{
+    mockBoard *pboard;
+    int type;
+
+    gtrMockVmeInstall();
+    if(!typeName) typeName = "";
+    for(type=0; type<mockNTypes; type++) {
+        if(strcmp(typeName,mockTypeName[type])==0) break;
+    }
+    if(type>=mockNTypes) {
+        printf("gtrMockVmeConfig: unknown type \"%s\". Choose one of",typeName);
+        for(type=0; type<mockNTypes; type++)
+            printf(" %s",mockTypeName[type]);
+        printf("\n");
+        return(-1);
+    }
+    if(intVec<0 || intVec>=NVECTORS) {
+        printf("gtrMockVmeConfig: illegal intVec %d\n",intVec);
+        return(-1);
+    }
+    pboard = calloc(1,sizeof(mockBoard));
+    if(!pboard) {
+        printf("gtrMockVmeConfig: calloc failed\n");
+        return(-1);
+    }
+    pboard->type = type;
+    pboard->intVec = intVec;
+    pboard->samples = samples;
+    pboard->a16offset = a16offset;
+    pboard->a32offset = a32offset;
+    switch(pboard->type) {
+    case mockVtr1012:
+        if(pboard->samples<=0) pboard->samples = vtr1012MemorySize[0];
+        pboard->a32size = pboard->samples*2*vtr1012Channels(pboard);
+        break;
+    case mockVtr10010:
+        pboard->a32size = vtr1012MemorySize[6]*2;
+        break;
+    default:
+        pboard->a32size = 0x01000000;
+        break;
+    }
+    /* The SIS boards have all registers in A32 */
+    if(pboard->type!=mockSis3300 && pboard->type!=mockSis3301) {
+        pboard->a16 = calloc(1,A16SIZE);
+        if(!pboard->a16) {
+            printf("gtrMockVmeConfig: calloc failed\n");
+            return(-1);
+        }
+    }
+    pboard->a32 = calloc(1,pboard->a32size);
+    if(!pboard->a32) {
+        printf("gtrMockVmeConfig: calloc failed\n");
+        return(-1);
+    }
+    switch(pboard->type) {
+    case mockSis3300: case mockSis3301:
+        sisSetup(pboard); break;
+    case mockVtr10012: case mockVtr10012_8:
+    case mockVtr8014: case mockVtr10014:
+        vtr10012Setup(pboard); break;
+    case mockVtr812: case mockVtr812_40:
+        vtr812Setup(pboard); break;
+    case mockVtr1012: case mockVtr10010:
+        vtr1012Setup(pboard); break;
+    }
+    epicsMutexLock(mockLock);
+    ellAdd(&boardList,&pboard->node);
+    epicsMutexUnlock(mockLock);
+    if(!pollTid) {
+        pollTid = epicsThreadCreate("gtrMockVme",epicsThreadPriorityHigh,
+            epicsThreadGetStackSize(epicsThreadStackSmall),pollThread,0);
+        if(!pollTid) printf("gtrMockVmeConfig: epicsThreadCreate failed\n");
+    }
+    return(0);
+}
+
+int gtrMockVmeTrigger(int intVec,int location)
+{
+    mockBoard *pboard;
+
+    if(!mockIsInited) return(-1);
+    epicsMutexLock(mockLock);
+    pboard = (mockBoard *)ellFirst(&boardList);
+    while(pboard) {
+        if(pboard->intVec==intVec) break;
+        pboard = (mockBoard *)ellNext(&pboard->node);
+    }
+    if(pboard) boardTrigger(pboard,location);
+    epicsMutexUnlock(mockLock);
+    if(!pboard) {
+        printf("gtrMockVmeTrigger: no board with intVec %#x\n",intVec);
+        return(-1);
+    }
+    return(0);
+}
+
+void gtrMockVmeReport(int level)
+{
+    mockBoard *pboard;
+
+    if(!mockIsInited) return;
+    pboard = (mockBoard *)ellFirst(&boardList);
+    while(pboard) {
+        printf("%s a16 %#x a32 %#x intVec %#x samples %d"
+            " triggers %lu spurious %lu\n",
+            mockTypeName[pboard->type],pboard->a16offset,pboard->a32offset,
+            pboard->intVec,pboard->samples,
+            pboard->ntriggers,pboard->nspurious);
+        if(level>0) {
+            printf("    a16 %p a32 %p a32size %#lx\n",
+                pboard->a16,pboard->a32,(unsigned long)pboard->a32size);
+        }
+        pboard = (mockBoard *)ellNext(&pboard->node);
+    }
+}
+
+/*
+ * IOC shell command registration
+ */
+#include <iocsh.h>
+static const iocshArg gtrMockVmeConfigArg0 = { "type",iocshArgString};
+static const iocshArg gtrMockVmeConfigArg1 = { "VME A16 offset",iocshArgInt};
+static const iocshArg gtrMockVmeConfigArg2 = { "VME A32 offset",iocshArgInt};
+static const iocshArg gtrMockVmeConfigArg3 = { "interrupt vector",iocshArgInt};
+static const iocshArg gtrMockVmeConfigArg4 = { "samples",iocshArgInt};
+static const iocshArg *gtrMockVmeConfigArgs[] = {
+    &gtrMockVmeConfigArg0, &gtrMockVmeConfigArg1, &gtrMockVmeConfigArg2,
+    &gtrMockVmeConfigArg3, &gtrMockVmeConfigArg4};
+static const iocshFuncDef gtrMockVmeConfigFuncDef =
+                      {"gtrMockVmeConfig",5,gtrMockVmeConfigArgs};
+static void gtrMockVmeConfigCallFunc(const iocshArgBuf *args)
+{
+    gtrMockVmeConfig(args[0].sval, args[1].ival, args[2].ival,
+                 args[3].ival, args[4].ival);
+}
+
+static const iocshArg gtrMockVmeTriggerArg0 = { "interrupt vector",iocshArgInt};
+static const iocshArg gtrMockVmeTriggerArg1 = { "location",iocshArgInt};
+static const iocshArg *gtrMockVmeTriggerArgs[] = {
+    &gtrMockVmeTriggerArg0, &gtrMockVmeTriggerArg1};
+static const iocshFuncDef gtrMockVmeTriggerFuncDef =
+                      {"gtrMockVmeTrigger",2,gtrMockVmeTriggerArgs};
+static void gtrMockVmeTriggerCallFunc(const iocshArgBuf *args)
+{
+    gtrMockVmeTrigger(args[0].ival, args[1].ival);
+}
+
+static const iocshArg gtrMockVmeReportArg0 = { "level",iocshArgInt};
+static const iocshArg *gtrMockVmeReportArgs[] = {&gtrMockVmeReportArg0};
+static const iocshFuncDef gtrMockVmeReportFuncDef =
+                      {"gtrMockVmeReport",1,gtrMockVmeReportArgs};
+static void gtrMockVmeReportCallFunc(const iocshArgBuf *args)
+{
+    gtrMockVmeReport(args[0].ival);
+}
+
+/*
+ * This routine is called before multitasking has started, so there's
+ * no race condition in the test/set of firstTime.
+ * It also installs the mock before any driver configuration command runs.
+ */
+static void
+gtrMockVmeRegisterCommands(void)
+{
+    static int firstTime = 1;
+    if (firstTime) {
+        gtrMockVmeInstall();
+        iocshRegister(&gtrMockVmeConfigFuncDef,gtrMockVmeConfigCallFunc);
+        iocshRegister(&gtrMockVmeTriggerFuncDef,gtrMockVmeTriggerCallFunc);
+        iocshRegister(&gtrMockVmeReportFuncDef,gtrMockVmeReportCallFunc);
+        firstTime = 0;
+    }
+}
+epicsExportRegistrar(gtrMockVmeRegisterCommands);
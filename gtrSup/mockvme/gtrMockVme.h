@@ -0,0 +1,39 @@
+/*gtrMockVme.h */
+
+/*************************************************************************
+* Copyright (c) 2002 The University of Chicago, as Operator of Argonne
+* National Laboratory, and the Regents of the University of California, as
+* Operator of Los Alamos National Laboratory. EPICS BASE Versions 3.13.7
+* and higher are distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*************************************************************************/
+
+#ifndef gtrMockVmeH
+#define gtrMockVmeH
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Must be called before the first devLib call, the registrar does this */
+void gtrMockVmeInstall(void);
+
+/* type is one of sis3300 sis3301 vtr10012 vtr10012_8 vtr8014 vtr10014
+ * vtr812 vtr812_40 vtr1012 vtr10010. Must precede the driver Config call.
+ * samples is per channel, 0 selects the board default.
+ */
+int gtrMockVmeConfig(const char *type,int a16offset,
+    unsigned int a32offset,int intVec,int samples);
+
+/* location is the trigger position within each event for prePostTrigger
+ * and is ignored for postTrigger. A negative value selects the middle.
+ */
+int gtrMockVmeTrigger(int intVec,int location);
+
+void gtrMockVmeReport(int level);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /*gtrMockVmeH*/
@@ -12,11 +12,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <errno.h>
 #include <limits.h>
 
 #include <menuFtype.h>
-#include <epicsDma.h>
 #include <epicsInterrupt.h>
 #include <epicsThread.h>
 #include <epicsExit.h>
@@ -28,13 +26,10 @@
 #include "drvSup.h"
 
 #include "drvGtr.h"
+#include "gtrUnpack.h"
+#include "gtrBtr.h"
 #include "drvSisfadc.h"
 
-/*
- * Size of local cache
- */
-#define DMA_BUFFER_CAPACITY   2048
-
 /*
  * Uncomment to produce timing signals on user output
 #define EMIT_TIMING_MARKERS 1
@@ -166,8 +161,7 @@ typedef struct sisInfo {
     gtrhandler usrIH;
     void        *handlerPvt;
     void        *userPvt;
-    epicsDmaId  dmaId;
-    long        *dmaBuffer;
+    gtrBtrId    btr;
 } sisInfo;
 
 static ELLLIST sisList;
@@ -267,68 +261,25 @@ void sisIH(void *arg)
     readRegister(psisInfo,INTCONTROL); /* Dummy read to flush writes */
 }
 
-STATIC void readContiguous(sisInfo *psisInfo,
-    gtrchannel *phigh,gtrchannel *plow,uint32 *pmemory,
-    int nmax,int *nskipHigh, int *nskipLow)
+STATIC int addPlan(sisInfo *psisInfo,gtrUnpackPlan *pplan,uint32 *pmemory)
 {
-    epicsInt16 high,low,himask,lomask;
-    int ind;
+    return(gtrBtrListAddPlan(psisInfo->btr,
+        (char *)pmemory - psisInfo->a32,pplan));
+}
+
+/* Reads every plan added by addPlan with one chained transfer */
+STATIC int readList(sisInfo *psisInfo)
+{
+    int status;
 
-    himask = lomask = psisInfo->psisTypeInfo->dataMask;
-    if(psisInfo->trigger == triggerFPGate)
-        lomask |= 0x8000;  /* Let G bit through */
-    for(ind=0; ind<nmax; ind++) {
-        uint32 word;
-        if(psisInfo->dmaId) {
-            if((psisInfo->dmaBuffer == NULL)
-             && ((psisInfo->dmaBuffer = malloc(DMA_BUFFER_CAPACITY*sizeof(epicsUInt32))) == NULL)) {
-                printf("No memory for SIS3301 DMA buffer.  Falling back to non-DMA opertaion\n");
-                psisInfo->dmaId = NULL;
-                word = pmemory[ind];
-            }
-            else {
-                int dmaInd = ind % DMA_BUFFER_CAPACITY;
-                if(dmaInd == 0) {
-                    unsigned int nnow = nmax - ind;
-                    if(nnow > DMA_BUFFER_CAPACITY)
-                        nnow = DMA_BUFFER_CAPACITY;
 #ifdef EMIT_TIMING_MARKERS
-                    writeRegister(psisInfo,CSR,0x00000002);
+    writeRegister(psisInfo,CSR,0x00000002);
 #endif
-                    if(epicsDmaFromVmeAndWait(psisInfo->dmaId,
-                                   psisInfo->dmaBuffer,
-                                   (unsigned long)(pmemory + ind),
-                                   VME_AM_EXT_SUP_ASCENDING,
-                                   nnow*sizeof(long),
-                                   sizeof(long)) != 0) {
-                        printf("Can't perform DMA: %s\n", strerror(errno));
-                        psisInfo->dmaId = NULL;
-                        psisInfo->dmaBuffer[dmaInd] = pmemory[ind];
-                    }
+    status = gtrBtrListRead(psisInfo->btr);
 #ifdef EMIT_TIMING_MARKERS
-                    writeRegister(psisInfo,CSR,0x00020000);
+    writeRegister(psisInfo,CSR,0x00020000);
 #endif
-                }
-                word = psisInfo->dmaBuffer[dmaInd];
-            }
-        }
-        else {
-            word = pmemory[ind];
-        }
-        if(*nskipHigh>0) {
-            --*nskipHigh;
-        } else if(phigh->ndata<phigh->len) {
-            high = (word>>16)&himask;
-            ((epicsInt16 *)phigh->pdata)[phigh->ndata++] = high;
-        }
-        if(*nskipLow>0) {
-            --*nskipLow;
-        } else if(plow->ndata<plow->len) {
-            low = word&lomask;
-            ((epicsInt16 *)plow->pdata)[plow->ndata++] = low;
-        }
-        if((phigh->ndata>=phigh->len) && (plow->ndata>=plow->len)) break;
-    }
+    return(status);
 }
 
 STATIC void sisinit(gtrPvt pvt)
@@ -350,6 +301,7 @@ STATIC void sisinit(gtrPvt pvt)
     writeRegister(psisInfo,INTCONFIG,
         (0x00001800 | (psisInfo->intLev <<8) | psisInfo->intVec));
     writeRegister(psisInfo,CSR,0x00000001); /* turn on user LED */
+    gtrBtrCalibrate(psisInfo->btr,MEMORYSTART,0x80000);
     return;
 }
 
@@ -380,6 +332,7 @@ STATIC void sisreport(gtrPvt pvt,int level)
     value = readRegister(psisInfo,READMAXEVENTS);
     printf(" MAXEVENTS %u",value);
     printf("\n");
+    gtrBtrReport(psisInfo->btr,level);
 }
 
 STATIC gtrStatus sisclock(gtrPvt pvt, int value)
@@ -541,8 +494,13 @@ STATIC gtrStatus sisreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
     char *pbank;
     int indgroup;
     int numberPPS = psisInfo->numberPPS;
+    epicsUInt16 himask,lomask;
 
+    himask = lomask = psisInfo->psisTypeInfo->dataMask;
+    if(psisInfo->trigger == triggerFPGate)
+        lomask |= 0x8000;  /* Let G bit through */
     pbank = psisInfo->a32 + MEMORYSTART;
+    gtrBtrListClear(psisInfo->btr);
     for(indgroup=0; indgroup<4; indgroup++) {
         gtrchannel *phigh;
         gtrchannel *plow;
@@ -596,20 +554,10 @@ STATIC gtrStatus sisreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
 #ifdef EMIT_TIMING_MARKERS
                     if(indgroup==0) writeRegister(psisInfo,CSR,0x00000002);
 #endif
-                    if(psisInfo->dmaId) {
-                        if(epicsDmaFromVmeAndWait(psisInfo->dmaId,
-                                       ((long *)phigh->pdata+phigh->ndata),
-                                       (long)pevent,
-                                       VME_AM_EXT_SUP_ASCENDING,
-                                       nnow*sizeof(long),
-                                       sizeof(long)) != 0) {
-                            printf("Can't perform DMA: %s\n", strerror(errno));
-                            return(gtrStatusError);
-                        }
-                    }
-                    else {
-                        bcopyLongs((char *)pevent,(char *)((long *)phigh->pdata+phigh->ndata),nnow);
-                    }
+                    if(gtrBtrCopy(psisInfo->btr,(char *)pevent - psisInfo->a32,
+                        nnow*sizeof(epicsUInt32),
+                        (epicsUInt32 *)phigh->pdata+phigh->ndata) != 0)
+                        return(gtrStatusError);
 #ifdef EMIT_TIMING_MARKERS
                     if(indgroup==0) writeRegister(psisInfo,CSR,0x00020000);
 #endif
@@ -624,8 +572,9 @@ STATIC gtrStatus sisreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
         }
         else {
             for(indevent=0; indevent<nevents; indevent++) {
-                int nhigh,nlow,nmax,nskipHigh,nskipLow;
+                int nhigh,nlow,nmax;
                 uint32 *pevent;
+                gtrUnpackPlan plan;
     
                 nhigh = phigh->len - phigh->ndata;
                 if(nhigh>numberPPS) nhigh = numberPPS;
@@ -641,35 +590,27 @@ STATIC gtrStatus sisreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
                           nnow = readRegister(psisInfo,BANK1ADDRESS);
                       else
                           nnow = readRegister(psisInfo,STOPDELAY);
-                      nskipHigh = nskipLow = 0;
-                      readContiguous(psisInfo,phigh,plow,
-                          pevent,nnow,&nskipHigh,&nskipLow);
+                      gtrUnpackPlanMake(&plan,nnow,0,nnow,
+                          phigh,himask,0,plow,lomask,0);
+                      if(addPlan(psisInfo,&plan,pevent))
+                          return(gtrStatusError);
                     }
                     break;
                 case armPrePostTrigger: {
                         volatile int *ptriggerInfo;
-                        int endAddress;
+                        int endAddress,start;
     
                         ptriggerInfo = (volatile int *)
                             (psisInfo->a32 + 0x201000 + indevent*4);
                         endAddress =  *ptriggerInfo & 0x0000ffff;
-                        nskipHigh = nmax - nhigh;
-                        nskipLow = nmax - nlow;
-                        if(endAddress < nmax) {
-                            int nend,nbeg;
-            
-                            nend = nmax - endAddress;
-                            nbeg = nmax - nend;
-                            readContiguous(psisInfo,phigh,plow,
-                                (pevent + eventsize - nend),nend,
-                                &nskipHigh,&nskipLow);
-                            readContiguous(psisInfo,phigh,plow,
-                                pevent,nbeg,&nskipHigh,&nskipLow);
-                        } else {
-                            readContiguous(psisInfo,phigh,plow,
-                                (pevent + endAddress - nmax),nmax,
-                                &nskipHigh,&nskipLow);
-                        }
+                        /* The nmax words before endAddress, wrapping to the
+                         * end of the event */
+                        start = endAddress - nmax;
+                        if(start<0) start += eventsize;
+                        gtrUnpackPlanMake(&plan,eventsize,start,nmax,
+                            phigh,himask,nmax - nhigh,plow,lomask,nmax - nlow);
+                        if(addPlan(psisInfo,&plan,pevent))
+                            return(gtrStatusError);
                     }
                     break;
                 default:
@@ -678,9 +619,16 @@ STATIC gtrStatus sisreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
             }
         }
     }
+    if(readList(psisInfo)) return(gtrStatusError);
     return(gtrStatusOK);
 }
 
+/* All channels but LONG ones are read with unpack plans */
+STATIC int sisreadsFloat(gtrPvt pvt)
+{
+    return(1);
+}
+
 STATIC gtrStatus sisgetLimits(gtrPvt pvt,epicsInt32 *rawLow,epicsInt32 *rawHigh)
 {
     sisInfo *psisInfo = (sisInfo *)pvt;
@@ -775,7 +723,9 @@ sisname,
 0, /*setUser*/
 0, /*getUser*/
 0, /*lock*/
-0  /*unlock*/
+0, /*unlock*/
+0, /*startReadMemory*/
+sisreadsFloat
 };
 
 int sisfadcConfig(int card,int clockSpeed,
@@ -853,14 +803,13 @@ int sisfadcConfig(int card,int clockSpeed,
     psisInfo->intVec = intVec;
     psisInfo->intLev = intLev;
     writeRegister(psisInfo,RESET,1);
-    if(useDma) {
-        psisInfo->dmaId = epicsDmaCreate(NULL, NULL);
-        if(psisInfo->dmaId == NULL)
-            printf("sisfadcConfig: DMA requested, but not available.\n");
-    }
-    else {
-        psisInfo->dmaId = NULL;
-    }
+    /* The sis3300 and sis3301 support MBLT64 but not 2eSST */
+    psisInfo->btr = gtrBtrCreate(psisInfo->name,a32offset,a32,useDma,
+        epicsDmaMBLT64);
+    if(psisInfo->btr == NULL)
+        return(0);
+    if(useDma && !gtrBtrUsesDma(psisInfo->btr))
+        printf("sisfadcConfig: DMA requested, but not available.\n");
     ellAdd(&sisList,&psisInfo->node);
     gtrRegisterDriver(card,psisInfo->name,&sisfadcops,psisInfo);
     return(0);
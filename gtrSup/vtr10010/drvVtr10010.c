@@ -26,6 +26,7 @@
 #include "drvSup.h"
 
 #include "drvGtr.h"
+#include "gtrBtr.h"
 #include "drvVtr10010.h"
 
 typedef unsigned char uint8;
@@ -79,6 +80,8 @@ typedef struct vtrInfo {
     char    *a16;
     int     a32offset;
     char    *a32;
+    int     useDma;
+    gtrBtrId btr;
     int     intVec;
     int     intLev;
     uint8   csr1byte0;  /*keep write state*/
@@ -229,6 +232,7 @@ STATIC void vtrinit(gtrPvt pvt)
     if(status) {
         errMessage(status,"vtrinit devEnableInterruptLevel failed\n");
     }
+    gtrBtrCalibrate(pvtrInfo->btr,0,pvtrInfo->arraySize*2);
     return;
 }
 
@@ -256,6 +260,7 @@ STATIC void vtrreport(gtrPvt pvt,int level)
     value = readRegister(pvtrInfo,IDREG);
     printf(" IDREG %hx",value);
     printf("\n");
+    gtrBtrReport(pvtrInfo->btr,level);
 }
 
 STATIC gtrStatus vtrclock(gtrPvt pvt, int value)
@@ -401,9 +406,7 @@ STATIC gtrStatus vtrreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
     gtrchannel *pgtrchannel;
     epicsInt16 *buffer;
     int len,ndata;
-    epicsInt16 data;
     epicsInt16 *lowBeg,*lowStop,*highBeg,*highStop;
-    epicsInt16 *pdata;
 
     pgtrchannel = papgtrchannel[0];
     len = pgtrchannel->len;
@@ -414,16 +417,14 @@ STATIC gtrStatus vtrreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
         pvtrInfo->prePost,len,readLocation(pvtrInfo),
         pvtrInfo->channel,pvtrInfo->arraySize,
         &lowBeg,&lowStop,&highBeg,&highStop);
-    for(pdata=highBeg; pdata < highStop; pdata++) {
-        data = *pdata;
-        data = (data&0x3ff);
-        *buffer++ = data;
-    }
-    for(pdata=lowBeg; pdata < lowStop; pdata++) {
-        data = *pdata;
-        data = (data&0x3ff);
-        *buffer++ = data;
-    }
+    gtrBtrListClear(pvtrInfo->btr);
+    if(gtrBtrListAddMasked(pvtrInfo->btr,(char *)highBeg - pvtrInfo->a32,
+        (highStop - highBeg)*sizeof(epicsInt16),buffer,0x3ff)
+    || gtrBtrListAddMasked(pvtrInfo->btr,(char *)lowBeg - pvtrInfo->a32,
+        (lowStop - lowBeg)*sizeof(epicsInt16),
+        buffer + (highStop - highBeg),0x3ff)
+    || gtrBtrListRead(pvtrInfo->btr))
+        return(gtrStatusError);
     pgtrchannel->ndata = ndata;
     return(gtrStatusOK);
 }
@@ -496,7 +497,8 @@ vtrtriggerChoices,
 0,0,0,0,0
 };
 
-int vtr10010Config(int card,int a16offset,unsigned int a32offset,int intVec)
+int vtr10010Config(int card,int a16offset,unsigned int a32offset,int intVec,
+    int useDma)
 {
     char *a16;
     gtrops *pgtrops;
@@ -551,6 +553,12 @@ int vtr10010Config(int card,int a16offset,unsigned int a32offset,int intVec)
         return(0);
     }
     pvtrInfo->a32 = a32;
+    pvtrInfo->useDma = useDma;
+    pvtrInfo->btr = gtrBtrCreate(vtrname,a32offset,a32,useDma,
+        epicsDmaBLT32);
+    if(!pvtrInfo->btr) return(0);
+    if(useDma && !gtrBtrUsesDma(pvtrInfo->btr))
+        printf("vtrConfig: DMA requested, but not available.\n");
     pvtrInfo->channel = (epicsInt16 *)pvtrInfo->a32;
     status = devConnectInterruptVME(pvtrInfo->intVec,
         vtr10010IH,(void *)pvtrInfo);
@@ -571,14 +579,16 @@ static const iocshArg vtr10010ConfigArg0 = { "card",iocshArgInt};
 static const iocshArg vtr10010ConfigArg1 = { "VME A16 offset",iocshArgInt};
 static const iocshArg vtr10010ConfigArg2 = { "VME memory offset",iocshArgInt};
 static const iocshArg vtr10010ConfigArg3 = { "interrupt vector",iocshArgInt};
+static const iocshArg vtr10010ConfigArg4 = { "use DMA",iocshArgInt};
 static const iocshArg *vtr10010ConfigArgs[] = {
     &vtr10010ConfigArg0, &vtr10010ConfigArg1,
-    &vtr10010ConfigArg2, &vtr10010ConfigArg3};
+    &vtr10010ConfigArg2, &vtr10010ConfigArg3, &vtr10010ConfigArg4};
 static const iocshFuncDef vtr10010ConfigFuncDef =
-                      {"vtr10010Config",4,vtr10010ConfigArgs};
+                      {"vtr10010Config",5,vtr10010ConfigArgs};
 static void vtr10010ConfigCallFunc(const iocshArgBuf *args)
 {
-    vtr10010Config(args[0].ival, args[1].ival, args[2].ival, args[3].ival);
+    vtr10010Config(args[0].ival, args[1].ival, args[2].ival, args[3].ival,
+        args[4].ival);
 }
 
 /*
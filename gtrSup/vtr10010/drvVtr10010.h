@@ -18,7 +18,8 @@
 extern "C" {
 #endif
 
-int vtr10010Config(int card,int a16offset,unsigned int a32offset,int intVec);
+int vtr10010Config(int card,int a16offset,unsigned int a32offset,int intVec,
+    int useDma);
 
 #ifdef __cplusplus
 }
@@ -14,16 +14,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <errno.h>
 
 #include <epicsInterrupt.h>
 #include <epicsThread.h>
 #include <epicsExit.h>
 #include <epicsExport.h>
 
-/*Following needed for block transfer requests*/
 #include <menuFtype.h>
-#include <epicsDma.h>
 
 #include "ellLib.h"
 #include "errlog.h"
@@ -31,6 +28,8 @@
 #include "drvSup.h"
 
 #include "drvGtr.h"
+#include "gtrUnpack.h"
+#include "gtrBtr.h"
 #include "drvVtr10012.h"
 
 typedef unsigned int uint32;
@@ -141,7 +140,7 @@ static char *armChoices[narmChoices] = {
 
 typedef struct vtrInfo {
     ELLNODE node;
-    epicsDmaId dmaId;
+    gtrBtrId btr;
     int     card;
     vtrType type;
     int     nchannels;
@@ -149,7 +148,6 @@ typedef struct vtrInfo {
     char    *a16;
     int     memoffset;
     char    *memory;
-    uint32  *buffer;
     int     intVec;
     int     intLev;
     int     indMultiEventNumber;
@@ -169,33 +167,6 @@ static int vtrIsInited = 0;
 static int isRebooting;
 #define isArmed(pvtrInfo) ((readRegister((pvtrInfo),STATUSR)&0x01) ? 1 : 0)
 
-static int dmaRead(epicsDmaId dmaId,uint32 vmeaddr,uint32 *buffer,int len)
-{
-    int status;
-
-    if(vtr10012Debug)
-        printf("dmaRead(%p,%x,%p,%d)\n",dmaId,vmeaddr,buffer,len);
-
-    /*
-     * Can use block transfer only on 256-byte boundary
-     */
-    status = epicsDmaFromVmeAndWait(dmaId,(void *)buffer,
-                                            vmeaddr,
-                                            (vmeaddr & 0xFF) ?
-                                                    VME_AM_EXT_SUP_DATA :
-                                                    VME_AM_EXT_SUP_ASCENDING,
-                                            len,
-                                            4);
-    if(status) {
-        printf("vtr10012: dmaRead error %s\n",strerror(errno));
-        return(-1);
-    }
-    if(vtr10012Debug) {
-        printf("dmaRead OK, vmeaddr %8.8x len %d\n",vmeaddr,len);
-    }
-    return(0);
-}
-
 static void writeRegister(vtrInfo *pvtrInfo, int offset,uepicsInt16 value)
 {
     char *a16 = pvtrInfo->a16;
@@ -301,6 +272,7 @@ STATIC void vtrinit(gtrPvt pvt)
     writeRegister(pvtrInfo,INTSTATUS,pvtrInfo->intVec);
     writeRegister(pvtrInfo,INTSETUP,pvtrInfo->intLev);
     writeRegister(pvtrInfo,A32BASE,(pvtrInfo->memoffset)>>24);
+    gtrBtrCalibrate(pvtrInfo->btr,0,0x00400000);
     return;
 }
 
@@ -319,6 +291,7 @@ STATIC void vtrreport(gtrPvt pvt,int level)
                                                 readRegister(pvtrInfo,CLOCK));
         printf("Gate Duration:%u\n",
                 (readRegister(pvtrInfo,HGDR)<<16)|readRegister(pvtrInfo,LGDR));
+        gtrBtrReport(pvtrInfo->btr,level);
     }
 }
 
@@ -442,82 +415,36 @@ STATIC gtrStatus vtrsoftTrigger(gtrPvt pvt)
     return(gtrStatusOK);
 }
 
-STATIC void readContiguous(vtrInfo *pvtrInfo,
-    gtrchannel *phigh,gtrchannel *plow,uint32 *pmemory,
-    int nmax,int *nskipHigh, int *nskipLow)
+STATIC int addPlan(vtrInfo *pvtrInfo,gtrUnpackPlan *pplan,uint32 *pmemory)
 {
-    epicsInt16 high,low,mask;
-    int ind;
-    int bufOffset = BUFLEN;
-
     if(vtr10012Debug)
-        printf("readContiguous pmemory %p nmax %d\n",pmemory,nmax);
-    mask = dataMask[pvtrInfo->type];
-    for(ind=0; ind<nmax; ind++) {
-        uint32 word;
-
-        if(pvtrInfo->dmaId && !pvtrInfo->buffer) {
-            pvtrInfo->buffer = calloc(BUFLEN,sizeof(uint32));
-            if(!pvtrInfo->buffer) {
-                printf("vtrConfig: calloc failed\n");
-                pvtrInfo->dmaId = 0;
-            }
-        }
-        if(pvtrInfo->dmaId) {
-            if(bufOffset>=BUFLEN) {
-                int status;
-                uint32 VMEaddr,bytesRemaining,bytesMax,nbytes;
-                VMEaddr = pvtrInfo->memoffset
-                    + ((char *)(pmemory) - pvtrInfo->memory)
-                    + ind * sizeof(uint32);
-                bytesRemaining = (nmax-ind)*sizeof(uint32);
-                bytesMax = BUFLEN*sizeof(uint32);
-                nbytes = (bytesRemaining<bytesMax) ? bytesRemaining : bytesMax;
-                status = dmaRead(pvtrInfo->dmaId,VMEaddr,pvtrInfo->buffer,nbytes);
-                if(status) break;
-                bufOffset = 0;
-            }
-            word = pvtrInfo->buffer[bufOffset++];
-        } else {
-            word = pmemory[ind];
-        }
-        if(*nskipHigh>0) {
-            --*nskipHigh;
-        } else if(phigh->ndata<phigh->len) {
-            high = (word>>16)&mask;
-            ((epicsInt16 *)phigh->pdata)[phigh->ndata++] = high;
-        }
-        if(*nskipLow>0) {
-            --*nskipLow;
-        } else if(plow->ndata<plow->len) {
-            low = word&mask;
-            ((epicsInt16 *)plow->pdata)[plow->ndata++] = low;
-        }
-        if((phigh->ndata>=phigh->len) && (plow->ndata>=plow->len)) break;
-    }
+        printf("addPlan pmemory %p nspan %d\n",pmemory,pplan->nspan);
+    return(gtrBtrListAddPlan(pvtrInfo->btr,
+        (char *)pmemory - pvtrInfo->memory,pplan));
 }
 
 STATIC gtrStatus readPostTrigger(vtrInfo *pvtrInfo,gtrchannel **papgtrchannel)
 {
+    epicsUInt16 mask = dataMask[pvtrInfo->type];
     int indgroup;
 
     for(indgroup=0; indgroup<4; indgroup++) {
         uint32 *pgroup = (uint32 *)(pvtrInfo->memory + indgroup*0x00400000);
-        gtrchannel *phigh,*plow;
-        int ndata,nskipHigh,nskipLow;
+        gtrUnpackPlan plan;
+        int ndata;
 
         ndata = pvtrInfo->numberPTS * pvtrInfo->numberPTE;
         if(ndata>pvtrInfo->arraySize) ndata = pvtrInfo->arraySize;
-        phigh = papgtrchannel[indgroup + 4];
-        plow = papgtrchannel[indgroup];
-        nskipHigh = nskipLow = 0;
-        readContiguous(pvtrInfo,phigh,plow,pgroup,ndata,&nskipHigh,&nskipLow);
+        gtrUnpackPlanMake(&plan,ndata,0,ndata,
+            papgtrchannel[indgroup + 4],mask,0,papgtrchannel[indgroup],mask,0);
+        if(addPlan(pvtrInfo,&plan,pgroup)) return(gtrStatusError);
     }
     return(gtrStatusOK);
 }
-
+
 STATIC gtrStatus readPrePostTrigger(vtrInfo *pvtrInfo,gtrchannel **papgtrchannel)
 {
+    epicsUInt16 mask = dataMask[pvtrInfo->type];
     int numberPPS = pvtrInfo->numberPPS;
     int nevents = pvtrInfo->numberEvents;
     int indevent,eventsize;
@@ -546,7 +473,8 @@ STATIC gtrStatus readPrePostTrigger(vtrInfo *pvtrInfo,gtrchannel **papgtrchannel
             uint32 *pgroup = (uint32 *)(pvtrInfo->memory + indgroup*0x00400000);
             uint32 *pmemory = pgroup + indevent*eventsize;
             gtrchannel *phigh,*plow;
-            int nskipHigh,nskipLow,nhigh,nlow,nmax;
+            gtrUnpackPlan plan;
+            int nhigh,nlow,nmax,start;
     
             phigh = papgtrchannel[indgroup + 4];
             plow = papgtrchannel[indgroup];
@@ -556,28 +484,17 @@ STATIC gtrStatus readPrePostTrigger(vtrInfo *pvtrInfo,gtrchannel **papgtrchannel
             if(nlow>numberPPS) nlow = numberPPS;
             nmax = (nhigh>nlow) ? nhigh : nlow;
             if(nmax<=0) continue;
-            nskipHigh = nmax - nhigh;
-            nskipLow = nmax - nlow;
-            if(location < nmax) {
-                int nend,nbeg;
-
-                nend = nmax - location;
-                nbeg = nmax - nend;
-                readContiguous(pvtrInfo,phigh,plow,
-                    (pmemory + eventsize - nend),nend,
-                    &nskipHigh,&nskipLow);
-                readContiguous(pvtrInfo,phigh,plow,
-                    pmemory,nbeg,&nskipHigh,&nskipLow);
-            } else {
-                readContiguous(pvtrInfo,phigh,plow,
-                    (pmemory + location - nmax),nmax,
-                    &nskipHigh,&nskipLow);
-            }
+            /* The nmax words before location, wrapping to the event end */
+            start = location - nmax;
+            if(start<0) start += eventsize;
+            gtrUnpackPlanMake(&plan,eventsize,start,nmax,
+                phigh,mask,nmax - nhigh,plow,mask,nmax - nlow);
+            if(addPlan(pvtrInfo,&plan,pmemory)) return(gtrStatusError);
         }
     }
     return(gtrStatusOK);
 }
-
+
 STATIC gtrStatus vtrreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
 {
     vtrInfo *pvtrInfo = (vtrInfo *)pvt;
@@ -595,11 +512,14 @@ STATIC gtrStatus vtrreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
         phigh->ndata=0;
         plow->ndata=0;
     }
+    /* The plans of all groups and events are read as one list */
+    gtrBtrListClear(pvtrInfo->btr);
     if(pvtrInfo->arm==armPostTrigger) {
-        readPostTrigger(pvtrInfo,papgtrchannel);
+        if(readPostTrigger(pvtrInfo,papgtrchannel)) return(gtrStatusError);
     } else if(pvtrInfo->arm==armPrePostTrigger) {
-        readPrePostTrigger(pvtrInfo,papgtrchannel);
+        if(readPrePostTrigger(pvtrInfo,papgtrchannel)) return(gtrStatusError);
     }  else { printf("Illegal arm request\n"); }
+    if(gtrBtrListRead(pvtrInfo->btr)) return(gtrStatusError);
     return(gtrStatusOK);
 }
 
@@ -626,16 +546,9 @@ STATIC gtrStatus vtrreadRawMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
             nnow = (readRegister(pvtrInfo,HMLC) << 16) | readRegister(pvtrInfo,LMLC);
             if(nnow>nchan)
                 nnow = nchan;
-            if(pvtrInfo->dmaId) {
-                if(dmaRead(pvtrInfo->dmaId,
-                        pvtrInfo->memoffset+((char *)pgroup-pvtrInfo->memory),
-                        (uint32 *)pchan->pdata,
-                        nnow*sizeof(uint32)) < 0)
-                    return(gtrStatusError);
-            }
-            else {
-                bcopyLongs((char *)pgroup, (char *)pchan->pdata, nnow);
-            }
+            if(gtrBtrCopy(pvtrInfo->btr,(char *)pgroup - pvtrInfo->memory,
+                nnow*sizeof(uint32),pchan->pdata))
+                return(gtrStatusError);
             pchan->ndata = nnow;
             break;
         
@@ -646,6 +559,12 @@ STATIC gtrStatus vtrreadRawMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
     return(gtrStatusOK);
 }
 
+/* FLOAT and DOUBLE channels are read with unpack plans */
+STATIC int vtrreadsFloat(gtrPvt pvt)
+{
+    return(1);
+}
+
 STATIC gtrStatus vtrgetLimits(gtrPvt pvt,epicsInt32 *rawLow,epicsInt32 *rawHigh)
 {
     vtrInfo *pvtrInfo = (vtrInfo *)pvt;
@@ -725,7 +644,9 @@ vtrarmChoices,
 vtrtriggerChoices,
 vtrmultiEventChoices,
 0, /* No preAverageChoices */
-0,0,0,0,0
+0,0,0,0,0,
+0, /* no startReadMemory */
+vtrreadsFloat
 };
 
 
@@ -740,8 +661,7 @@ int vtr10012Config(int card,
     long status;
     vtrType type;
     char *memory;
-    uint32 *buffer = 0;
-    epicsDmaId dmaId = 0;
+    gtrBtrId btr;
 
     if(!vtrIsInited) initialize();
     if(gtrFind(card,&pgtrops)) {
@@ -761,25 +681,11 @@ int vtr10012Config(int card,
         printf("vtrConfig: no card at %#x\n",a16offset);
         return(0);
     }
-    if (useDma) {
-        dmaId = epicsDmaCreate(NULL, NULL);
-        if(!dmaId)
-            printf("vtrConfig: DMA requested, but not available.\n");
-    }
     probeValue = (probeValue>>10);
     if(probeValue==7) {
         type = vtrType10012;
     } else if(probeValue==8) {
         type = vtrType10012_8;
-        if(!dmaId) {
-            printf("dma is not available but vtr10012_8 requires it.\n");
-            return(0);
-        }
-        buffer = calloc(BUFLEN,sizeof(uint32));
-        if(!buffer) {
-            printf("vtrConfig: calloc failed\n");
-            return(0);
-        }
     } else if(probeValue==9) {
         type = vtrType8014;
     } else if(probeValue==10) {
@@ -798,12 +704,22 @@ int vtr10012Config(int card,
         errMessage(status,"vtrConfig devRegisterAddress failed for memory\n");
         return(0);
     }
+    /* The vtr10012_8 memory can only be read by block transfer */
+    btr = gtrBtrCreate(vtrname[type],memoffset,
+        (type==vtrType10012_8) ? 0 : memory,useDma,epicsDmaBLT32);
+    if(!btr) return(0);
+    if(useDma && !gtrBtrUsesDma(btr))
+        printf("vtrConfig: DMA requested, but not available.\n");
+    if(type==vtrType10012_8 && !gtrBtrUsesDma(btr)) {
+        printf("dma is not available but vtr10012_8 requires it.\n");
+        return(0);
+    }
     pvtrInfo = calloc(1,sizeof(vtrInfo));
     if(!pvtrInfo) {
         printf("vtrConfig: calloc failed\n");
         return(0);
     }
-    pvtrInfo->dmaId = dmaId;
+    pvtrInfo->btr = btr;
     pvtrInfo->card = card;
     pvtrInfo->type = type;
     pvtrInfo->nchannels = (nchannels ? nchannels : 8);
@@ -815,7 +731,6 @@ int vtr10012Config(int card,
     pvtrInfo->intVec = intVec;
     pvtrInfo->intLev = intLev;
     pvtrInfo->numberPTE = 1;
-    pvtrInfo->buffer = buffer;
     if(type==vtrType10012_8) {
         pvtrInfo->numberPTS = NSAM10012_8;
         pvtrInfo->numberPTE = 1;
@@ -26,6 +26,7 @@
 #include "drvSup.h"
 
 #include "drvGtr.h"
+#include "gtrBtr.h"
 #include "drvVtr1012.h"
 
 #define STATIC static
@@ -62,6 +63,8 @@ typedef struct vtrInfo {
     char    *a16;
     int     a32offset;
     char    *a32;
+    int     useDma;
+    gtrBtrId btr;
     int     intVec;
     int     intLev;
     uint8   csr1byte0;  /*keep write state*/
@@ -249,6 +252,12 @@ STATIC void vtrinit(gtrPvt pvt)
         return;
     }
     pvtrInfo->a32 = a32;
+    pvtrInfo->btr = gtrBtrCreate(vtrname,pvtrInfo->a32offset,a32,
+        pvtrInfo->useDma,epicsDmaBLT32);
+    if(pvtrInfo->btr && pvtrInfo->useDma && !gtrBtrUsesDma(pvtrInfo->btr))
+        printf("vtrinit1012: DMA requested, but not available.\n");
+    if(pvtrInfo->btr)
+        gtrBtrCalibrate(pvtrInfo->btr,0,arraySize*2*nChannels1012);
     for(signal=0; signal<nChannels1012; signal++) {
         pvtrInfo->channel[signal] =
             (epicsInt16 *)(a32 + pvtrInfo->arraySize *signal * 2);
@@ -280,6 +289,7 @@ STATIC void vtrreport(gtrPvt pvt,int level)
     value = readRegister(pvtrInfo,IDREG);
     printf(" IDREG %hx",value);
     printf("\n");
+    if(pvtrInfo->btr) gtrBtrReport(pvtrInfo->btr,level);
 }
 
 STATIC gtrStatus vtrclock(gtrPvt pvt, int value)
@@ -425,13 +435,14 @@ STATIC gtrStatus vtrreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
     gtrchannel *pgtrchannel;
     epicsInt16 *buffer;
     int len,ndata;
-    epicsInt16 data;
     epicsInt16 *lowBeg,*lowStop,*highBeg,*highStop;
-    epicsInt16 *pdata;
     int signal;
     int location;
 
+    if(!pvtrInfo->btr) return(gtrStatusError);
     location = readLocationRegister(pvtrInfo);
+    /* Both parts of every channel are read as one list */
+    gtrBtrListClear(pvtrInfo->btr);
     for(signal=0; signal<nChannels1012; signal++) {
         pgtrchannel = papgtrchannel[signal];
         len = pgtrchannel->len;
@@ -442,18 +453,15 @@ STATIC gtrStatus vtrreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
             pvtrInfo->prePost,len,location,
             pvtrInfo->channel[signal],pvtrInfo->arraySize,
             &lowBeg,&lowStop,&highBeg,&highStop);
-        for(pdata=highBeg; pdata < highStop; pdata++) {
-            data = *pdata;
-            data = (data&0xfff);
-            *buffer++ = data;
-        }
-        for(pdata=lowBeg; pdata < lowStop; pdata++) {
-            data = *pdata;
-            data = (data&0xfff);
-            *buffer++ = data;
-        }
+        if(gtrBtrListAddMasked(pvtrInfo->btr,(char *)highBeg - pvtrInfo->a32,
+            (highStop - highBeg)*sizeof(epicsInt16),buffer,0xfff)
+        || gtrBtrListAddMasked(pvtrInfo->btr,(char *)lowBeg - pvtrInfo->a32,
+            (lowStop - lowBeg)*sizeof(epicsInt16),
+            buffer + (highStop - highBeg),0xfff))
+            return(gtrStatusError);
         pgtrchannel->ndata = ndata;
     }
+    if(gtrBtrListRead(pvtrInfo->btr)) return(gtrStatusError);
     return(gtrStatusOK);
 }
 
@@ -526,7 +534,7 @@ vtrtriggerChoices,
 };
 
 int vtr1012Config(int card,int a16offset,unsigned int a32offset,int intVec,
-    int channelArraySize)
+    int channelArraySize,int useDma)
 {
     char *a16;
     gtrops *pgtrops;
@@ -564,6 +572,7 @@ int vtr1012Config(int card,int a16offset,unsigned int a32offset,int intVec,
     pvtrInfo->card = card;
     pvtrInfo->a16 = a16;
     pvtrInfo->a32offset = a32offset;
+    pvtrInfo->useDma = useDma;
     pvtrInfo->intVec = intVec;
     pvtrInfo->numberPTE = 1;
     status = devConnectInterruptVME(pvtrInfo->intVec,
@@ -588,15 +597,16 @@ static const iocshArg vtr1012ConfigArg1 = { "VME A16 offset",iocshArgInt};
 static const iocshArg vtr1012ConfigArg2 = { "VME memory offset",iocshArgInt};
 static const iocshArg vtr1012ConfigArg3 = { "interrupt vector",iocshArgInt};
 static const iocshArg vtr1012ConfigArg4 = { "channel array size",iocshArgInt};
+static const iocshArg vtr1012ConfigArg5 = { "use DMA",iocshArgInt};
 static const iocshArg *vtr1012ConfigArgs[] = {
     &vtr1012ConfigArg0, &vtr1012ConfigArg1, &vtr1012ConfigArg2,
-    &vtr1012ConfigArg3, &vtr1012ConfigArg4};
+    &vtr1012ConfigArg3, &vtr1012ConfigArg4, &vtr1012ConfigArg5};
 static const iocshFuncDef vtr1012ConfigFuncDef =
-                      {"vtr1012Config",5,vtr1012ConfigArgs};
+                      {"vtr1012Config",6,vtr1012ConfigArgs};
 static void vtr1012ConfigCallFunc(const iocshArgBuf *args)
 {
     vtr1012Config(args[0].ival, args[1].ival, args[2].ival,
-                 args[3].ival, args[4].ival);
+                 args[3].ival, args[4].ival, args[5].ival);
 }
 
 /*
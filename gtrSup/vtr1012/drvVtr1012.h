@@ -19,7 +19,7 @@ extern "C" {
 #endif
 
 int vtr1012Config(int card,int a16offset,unsigned int a32offset,int intVec,
-    int channelArraySize);
+    int channelArraySize,int useDma);
 
 #ifdef __cplusplus
 }
@@ -14,22 +14,20 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <errno.h>
 
 #include <epicsInterrupt.h>
 #include <epicsThread.h>
 #include <epicsExit.h>
 #include <epicsExport.h>
 
-/*Following needed for block transfer requests*/
-#include <epicsDma.h>
-
 #include "ellLib.h"
 #include "errlog.h"
 #include "devLib.h"
 #include "drvSup.h"
 
 #include "drvGtr.h"
+#include "gtrUnpack.h"
+#include "gtrBtr.h"
 #include "drvVtr812.h"
 
 int vtr812Debug=0;
@@ -38,7 +36,6 @@ typedef unsigned int uint32;
 typedef unsigned char uint8;
 
 #define STATIC static
-#define BUFLEN 2048
 #define GROUPSIZE 0x100000
 #define GROUPMEMSIZE 0x400000
 #define nMemorySize 7
@@ -124,14 +121,13 @@ static char *armChoices[narmChoices] = {
 
 typedef struct vtrInfo {
     ELLNODE node;
-    epicsDmaId dmaId;
+    gtrBtrId btr;
     int     card;
     vtrType type;
     char    *a16;
     int     memsize;
     int     memoffset;
     char    *memory;
-    uint32  *buffer;
     int     intVec;
     int     intLev;
     int     hasMultiPrePost;
@@ -153,24 +149,6 @@ static int vtrIsInited = 0;
 static int isRebooting;
 #define isArmed(pvtrInfo) ((readRegister((pvtrInfo),CSR2)&0x40) ? 1 : 0)
 
-static int dmaRead(epicsDmaId dmaId,uint32 vmeaddr,uint32 *buffer,int len)
-{
-    int status;
-
-    if(vtr812Debug)
-        printf("dmaRead(%p,%x,%p,%d)\n",dmaId,vmeaddr,buffer,len);
-
-    status = epicsDmaFromVmeAndWait(dmaId,(void *)buffer,
-                                        vmeaddr,VME_AM_EXT_SUP_ASCENDING,len,4);
-    if(status) {
-        printf("vtr812: dmaRead error %s\n",strerror(errno));
-        return(-1);
-    }
-    if(vtr812Debug) {
-        printf("dmaRead OK, vmeaddr %8.8x len %d\n",vmeaddr,len);
-    }
-    return(0);
-}
 
 static void writeRegister(vtrInfo *pvtrInfo, int offset,uint8 value)
 {
@@ -296,6 +274,7 @@ STATIC void vtrinit(gtrPvt pvt)
     }
     writeRegister(pvtrInfo,CSR3,0x5);
     writeRegister(pvtrInfo,IntStatusID,pvtrInfo->intVec);
+    gtrBtrCalibrate(pvtrInfo->btr,0,GROUPMEMSIZE);
     return;
 }
 
@@ -308,6 +287,7 @@ STATIC void vtrreport(gtrPvt pvt,int level)
         pvtrInfo->a16,pvtrInfo->memory,
         pvtrInfo->intVec,pvtrInfo->intLev,
         (pvtrInfo->hasMultiPrePost ? "yes" : "no"));
+    if(level>=1) gtrBtrReport(pvtrInfo->btr,level);
 }
 
 STATIC gtrStatus vtrclock(gtrPvt pvt, int value)
@@ -454,75 +434,40 @@ STATIC gtrStatus vtrsoftTrigger(gtrPvt pvt)
     return(gtrStatusOK);
 }
 
-STATIC void readContiguous(vtrInfo *pvtrInfo,
-    gtrchannel *phigh,gtrchannel *plow,uint32 *pmemory,
-    int nmax,int *nskipHigh, int *nskipLow)
+STATIC int addPlan(vtrInfo *pvtrInfo,gtrUnpackPlan *pplan,uint32 *pmemory)
 {
-    epicsInt16 high,low,mask;
-    int ind;
-    int bufOffset = BUFLEN;
-
     if(vtr812Debug)
-        printf("readContiguous pmemory %p nmax %d\n",pmemory,nmax);
-    mask = dataMask[pvtrInfo->type];
-    for(ind=0; ind<nmax; ind++) {
-        uint32 word;
-
-        if(pvtrInfo->dmaId && vtr812UseDma) {
-            if(bufOffset>=BUFLEN) {
-                int status;
-                uint32 VMEaddr,bytesRemaining,bytesMax,nbytes;
-                VMEaddr = pvtrInfo->memoffset
-                    + ((char *)(pmemory) - pvtrInfo->memory)
-                    + ind * sizeof(uint32);
-                bytesRemaining = (nmax-ind)*sizeof(uint32);
-                bytesMax = BUFLEN*sizeof(uint32);
-                nbytes = (bytesRemaining<bytesMax) ? bytesRemaining : bytesMax;
-                status = dmaRead(pvtrInfo->dmaId,VMEaddr,pvtrInfo->buffer,nbytes);
-                if(status) break;
-                bufOffset = 0;
-            }
-            word = pvtrInfo->buffer[bufOffset++];
-        } else {
-            word = pmemory[ind];
-        }
-        if(*nskipHigh>0) {
-            --*nskipHigh;
-        } else if(phigh->ndata<phigh->len) {
-            high = (word>>16)&mask;
-            ((epicsInt16 *)phigh->pdata)[phigh->ndata++] = high;
-        }
-        if(*nskipLow>0) {
-            --*nskipLow;
-        } else if(plow->ndata<plow->len) {
-            low = word&mask;
-            ((epicsInt16 *)plow->pdata)[plow->ndata++] = low;
-        }
-        if((phigh->ndata>=phigh->len) && (plow->ndata>=plow->len)) break;
+        printf("addPlan pmemory %p nspan %d\n",pmemory,pplan->nspan);
+    if(!vtr812UseDma) {
+        gtrUnpackPlanRun(pplan,pmemory);
+        return(0);
     }
+    return(gtrBtrListAddPlan(pvtrInfo->btr,
+        (char *)pmemory - pvtrInfo->memory,pplan));
 }
 
 STATIC gtrStatus readPostTrigger(vtrInfo *pvtrInfo,gtrchannel **papgtrchannel)
 {
+    epicsUInt16 mask = dataMask[pvtrInfo->type];
     int indgroup;
 
     for(indgroup=0; indgroup<4; indgroup++) {
         uint32 *pgroup = (uint32 *)(pvtrInfo->memory + indgroup*GROUPMEMSIZE);
-        gtrchannel *phigh,*plow;
-        int ndata,nskipHigh,nskipLow;
+        gtrUnpackPlan plan;
+        int ndata;
 
         ndata = pvtrInfo->numberPTS * pvtrInfo->numberPTE;
         if(ndata>pvtrInfo->memsize) ndata = pvtrInfo->memsize;
-        phigh = papgtrchannel[indgroup + 4];
-        plow = papgtrchannel[indgroup];
-        nskipHigh = nskipLow = 0;
-        readContiguous(pvtrInfo,phigh,plow,pgroup,ndata,&nskipHigh,&nskipLow);
+        gtrUnpackPlanMake(&plan,ndata,0,ndata,
+            papgtrchannel[indgroup + 4],mask,0,papgtrchannel[indgroup],mask,0);
+        if(addPlan(pvtrInfo,&plan,pgroup)) return(gtrStatusError);
     }
     return(gtrStatusOK);
 }
-
+
 STATIC gtrStatus readPrePostTrigger(vtrInfo *pvtrInfo,gtrchannel **papgtrchannel)
 {
+    epicsUInt16 mask = dataMask[pvtrInfo->type];
     int numberPPS = pvtrInfo->numberPPS;
     int nevents = pvtrInfo->numberEvents;
     uint32 eventsize;
@@ -558,7 +503,8 @@ STATIC gtrStatus readPrePostTrigger(vtrInfo *pvtrInfo,gtrchannel **papgtrchannel
             uint32 *pgroup = (uint32 *)(pvtrInfo->memory + indgroup*GROUPMEMSIZE);
             uint32 *pmemory = pgroup + indevent*eventsize;
             gtrchannel *phigh,*plow;
-            int nskipHigh,nskipLow,nhigh,nlow,nmax;
+            gtrUnpackPlan plan;
+            int nhigh,nlow,nmax,start;
 
             phigh = papgtrchannel[indgroup + 4];
             plow = papgtrchannel[indgroup];
@@ -568,28 +514,17 @@ STATIC gtrStatus readPrePostTrigger(vtrInfo *pvtrInfo,gtrchannel **papgtrchannel
             if(nlow>numberPPS) nlow = numberPPS;
             nmax = (nhigh>nlow) ? nhigh : nlow;
             if(nmax<=0) continue;
-            nskipHigh = nmax - nhigh;
-            nskipLow = nmax - nlow;
-            if(location < nmax) {
-                int nend,nbeg;
-
-                nend = nmax - location;
-                nbeg = nmax - nend;
-                readContiguous(pvtrInfo,phigh,plow,
-                    (pmemory + eventsize - nend),nend,
-                    &nskipHigh,&nskipLow);
-                readContiguous(pvtrInfo,phigh,plow,
-                    pmemory,nbeg,&nskipHigh,&nskipLow);
-            } else {
-                readContiguous(pvtrInfo,phigh,plow,
-                    (pmemory + location - nmax),nmax,
-                    &nskipHigh,&nskipLow);
-            }
+            /* The nmax words before location, wrapping to the event end */
+            start = (int)location - nmax;
+            if(start<0) start += eventsize;
+            gtrUnpackPlanMake(&plan,eventsize,start,nmax,
+                phigh,mask,nmax - nhigh,plow,mask,nmax - nlow);
+            if(addPlan(pvtrInfo,&plan,pmemory)) return(gtrStatusError);
         }
     }
     return(gtrStatusOK);
 }
-
+
 STATIC gtrStatus vtrreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
 {
     vtrInfo *pvtrInfo = (vtrInfo *)pvt;
@@ -605,14 +540,23 @@ STATIC gtrStatus vtrreadMemory(gtrPvt pvt,gtrchannel **papgtrchannel)
         phigh->ndata=0;
         plow->ndata=0;
     }
+    /* The plans of all groups and events are read as one list */
+    gtrBtrListClear(pvtrInfo->btr);
     if(pvtrInfo->arm==armPostTrigger) {
-        readPostTrigger(pvtrInfo,papgtrchannel);
+        if(readPostTrigger(pvtrInfo,papgtrchannel)) return(gtrStatusError);
     } else if(pvtrInfo->arm==armPrePostTrigger) {
-        readPrePostTrigger(pvtrInfo,papgtrchannel);
+        if(readPrePostTrigger(pvtrInfo,papgtrchannel)) return(gtrStatusError);
     }  else { printf("Illegal arm request\n"); }
+    if(gtrBtrListRead(pvtrInfo->btr)) return(gtrStatusError);
     return(gtrStatusOK);
 }
 
+/* FLOAT and DOUBLE channels are read with unpack plans */
+STATIC int vtrreadsFloat(gtrPvt pvt)
+{
+    return(1);
+}
+
 STATIC gtrStatus vtrgetLimits(gtrPvt pvt,epicsInt32 *rawLow,epicsInt32 *rawHigh)
 {
     vtrInfo *pvtrInfo = (vtrInfo *)pvt;
@@ -693,7 +637,9 @@ vtrarmChoices,
 vtrtriggerChoices,
 vtrmultiEventChoices,
 0, /* no preAverageChoices */
-0,0,0,0,0
+0,0,0,0,0,
+0, /* no startReadMemory */
+vtrreadsFloat
 };
 
 
@@ -708,7 +654,6 @@ int vtr812Config(int card,
     long status;
     vtrType type;
     char *memory;
-    epicsDmaId dmaId = 0;
     uint8 idModType,idMemSize,multiIndex;
 
     if(!vtrIsInited) initialize();
@@ -731,7 +676,6 @@ int vtr812Config(int card,
     }
     idModType = probeValue&0x7;
     idMemSize = (probeValue>>3) &0x7;
-    dmaId = epicsDmaCreate(NULL, NULL);
     if(idModType==5) {
         type = vtrType812_10;
     } else if(idModType==6) {
@@ -759,14 +703,10 @@ int vtr812Config(int card,
         printf("vtrConfig: calloc failed\n");
         return(0);
     }
-    if(dmaId) {
-        pvtrInfo->buffer = calloc(BUFLEN,sizeof(uint32));
-        if(!pvtrInfo->buffer) {
-            printf("vtrConfig: calloc failed\n");
-            return(0);
-        }
-    }
-    pvtrInfo->dmaId = dmaId;
+    /* vtr812UseDma selects DMA at run time */
+    pvtrInfo->btr = gtrBtrCreate(vtrname[type],memoffset,memory,
+        epicsDmaBLT32,epicsDmaBLT32);
+    if(!pvtrInfo->btr) return(0);
     pvtrInfo->card = card;
     pvtrInfo->type = type;
     pvtrInfo->a16 = a16;
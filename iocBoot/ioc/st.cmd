@@ -20,6 +20,7 @@ cd startup
 #< vtr8014
 #< vtr812
 #< sis3300
+#< gtrsim
 < sis3301_long
 
 iocInit()
@@ -0,0 +1,15 @@
+#!../../bin/linux-x86_64/testGtr
+
+# Example soft IOC startup file. VME cards are simulated by gtrMockVme.
+
+< envPaths
+
+cd ${TOP}
+dbLoadDatabase("dbd/testGtrSoft.dbd")
+testGtrSoft_registerRecordDeviceDriver(pdbbase)
+
+cd ${TOP}/iocBoot/${IOC}
+< ../ioc/gtrsim
+#< mockVme
+
+iocInit()
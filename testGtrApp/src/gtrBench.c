@@ -0,0 +1,707 @@
+/*gtrBench.c */
+
+/* Times the readMemory methods of the VME transient recorder drivers.
+ * The boards are simulated by gtrMockVme so the numbers are for the
+ * driver unpack loops against host memory, i.e. the CPU part of a readout.
+ *
+ * Usage: gtrBench [-s seconds] [-n maxSamples] [-d useDma] [-b MB/s] [-a]
+ *     [-w workers] [board ...]
+ *        gtrBench -v
+ * board is one of sis3301 vtr10012 vtr812 vtr1012. Default is all.
+ * -d reads with DMA through the gtrMockDma host DMA engine, where useDma
+ * is the Config argument, and -b is its BLT32 bandwidth. MBLT64 gets
+ * twice and 2eSST four times that. The default 0 is as fast as memcpy.
+ * DMA is used for all reads unless -a is given, which lets gtrBtrCalibrate
+ * choose between DMA and direct reads as it does in an IOC.
+ *
+ * For every board the following are swept:
+ *     samples per channel 1k to 8M, limited by the board memory
+ *     number of events 1, 8, 16
+ *     postTrigger and prePostTrigger
+ *     channel masks all, lower half, channel 0
+ * Boards that support LONG waveforms also get a postTrigger LONG row,
+ * which copies the packed words without unpacking. Boards whose drivers
+ * readsFloat get a postTrigger FLOAT row, which unpacks and scales the
+ * samples straight into float waveform buffers.
+ *
+ * samples/s and ns/sample count the samples put into the waveform
+ * buffers. bytes/s counts the bytes put into the waveform buffers.
+ * With DMA they include the emulated VME transfer time.
+ *
+ * gtrBench -v runs no boards. It checks gtrUnpackPair, gtrUnpackHigh,
+ * gtrUnpackLow and the scale kernels against plain C loops, for lengths
+ * 0 to 70 and a few longer ones, with unaligned source and destination
+ * starts. It also checks that nothing is written outside the destination.
+ * It then checks gtrUnpackPlanMake with gtrUnpackPlanRun and with
+ * gtrUnpackPlanBlock, given random blocks in random order, against the
+ * per word loop the drivers used before plans, for circular buffers that
+ * wrap, skipped words, channels that fill up and several events per
+ * channel. The exit status is 1 if any case fails.
+ */
+
+/*************************************************************************
+* Copyright (c) 2002 The University of Chicago, as Operator of Argonne
+* National Laboratory, and the Regents of the University of California, as
+* Operator of Los Alamos National Laboratory. EPICS BASE Versions 3.13.7
+* and higher are distributed subject to a Software License Agreement found
+* in file LICENSE that is included with this distribution.
+*************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <epicsTypes.h>
+#include <epicsTime.h>
+#include <menuFtype.h>
+
+#include "drvGtr.h"
+#include "gtrUnpack.h"
+#include "gtrMockVme.h"
+#include "gtrMockDma.h"
+
+/* The driver Config commands have no header of their own */
+int sisfadcConfig(int card,int clockSpeed,
+    unsigned int a32offset,int intVec,int intLev, int useDma);
+int vtr10012Config(int card,
+    int a16offset,unsigned int memoffset,
+    int intVec,int intLev, int useDma, int nchannels, int kilosamplesPerChan);
+int vtr812Config(int card,
+    int a16offset,unsigned int memoffset,
+    int intVec);
+int vtr1012Config(int card,int a16offset,unsigned int a32offset,int intVec,
+    int channelArraySize,int useDma);
+extern int vtr812UseDma;
+extern int gtrBtrAutoDma;
+extern int gtrBtrWorkers;
+
+#define armPostTrigger    1
+#define armPrePostTrigger 2
+
+#define MINREADS 3
+
+static int useDma = 0;
+
+typedef struct benchBoard {
+    const char   *type;       /* gtrMockVme type */
+    int          card;
+    int          a16offset;
+    unsigned int a32offset;
+    int          intVec;
+    int          maxSamples;  /* samples per channel held by the board */
+    /* postTrigger events are counted with numberPTE, not multiEvent */
+    int          postEventsFromPTE;
+    /* gtrMockVme can only give the first prePostTrigger event a trigger
+     * location on the VTR10012 and VTR812, so they are read with 1 event */
+    int          prePostMultiEvent;
+    /* channels that get a LONG waveform, 0 if LONG is not supported */
+    int          longMask;
+    int          (*config)(struct benchBoard *pboard);
+    gtrPvt       pvt;
+    gtrops       *pgtrops;
+} benchBoard;
+
+static int sisConfig(benchBoard *pboard)
+{
+    return(sisfadcConfig(pboard->card,80,pboard->a32offset,
+        pboard->intVec,3,useDma));
+}
+
+static int vtr10012BenchConfig(benchBoard *pboard)
+{
+    return(vtr10012Config(pboard->card,pboard->a16offset,pboard->a32offset,
+        pboard->intVec,3,useDma,8,pboard->maxSamples/1024));
+}
+
+static int vtr812BenchConfig(benchBoard *pboard)
+{
+    return(vtr812Config(pboard->card,pboard->a16offset,pboard->a32offset,
+        pboard->intVec));
+}
+
+static int vtr1012BenchConfig(benchBoard *pboard)
+{
+    return(vtr1012Config(pboard->card,pboard->a16offset,pboard->a32offset,
+        pboard->intVec,pboard->maxSamples,useDma));
+}
+
+static benchBoard boards[] = {
+    {"sis3301", 5,0x0000,0xA1000000,0x88,128*1024, 0,1,0x55,sisConfig},
+    {"vtr10012",3,0xa200,0x82000000,0x85,1024*1024,1,0,0,   vtr10012BenchConfig},
+    {"vtr812",  7,0xa500,0x85000000,0x81,1024*1024,1,0,0,   vtr812BenchConfig},
+    {"vtr1012", 1,0xa100,0x81000000,0x82,8*1024*1024,1,0,0, vtr1012BenchConfig}
+};
+#define nboards (sizeof(boards)/sizeof(boards[0]))
+
+static int lengths[] = {
+    1024,4*1024,16*1024,64*1024,256*1024,1024*1024,4*1024*1024,8*1024*1024
+};
+#define nlengths (sizeof(lengths)/sizeof(lengths[0]))
+
+static int events[] = {1,8,16};
+#define nevents (sizeof(events)/sizeof(events[0]))
+
+static double minSeconds = 0.2;
+
+static int findMultiEvent(benchBoard *pboard,int nevent)
+{
+    int number,ind;
+    char **choice;
+
+    if(!pboard->pgtrops->multiEventChoices) return(-1);
+    if((*pboard->pgtrops->multiEventChoices)(pboard->pvt,&number,&choice)
+        !=gtrStatusOK) return(-1);
+    for(ind=0; ind<number; ind++) {
+        if(atoi(choice[ind])==nevent) return(ind);
+    }
+    return(-1);
+}
+
+static int setup(benchBoard *pboard,int arm,int nevent,int length)
+{
+    gtrops *pgtrops = pboard->pgtrops;
+    gtrPvt pvt = pboard->pvt;
+    int perEvent = length/nevent;
+    int indMulti,ind;
+
+    indMulti = findMultiEvent(pboard,nevent);
+    if(nevent>1 && !(arm==armPostTrigger && pboard->postEventsFromPTE)) {
+        if(indMulti<0) return(-1);
+        if(arm==armPrePostTrigger && !pboard->prePostMultiEvent) return(-1);
+    }
+    (*pgtrops->arm)(pvt,0);
+    if(indMulti>=0) (*pgtrops->multiEvent)(pvt,indMulti);
+    (*pgtrops->numberPTS)(pvt,perEvent);
+    (*pgtrops->numberPPS)(pvt,perEvent);
+    (*pgtrops->numberPTE)(pvt,nevent);
+    if((*pgtrops->arm)(pvt,arm)!=gtrStatusOK) return(-1);
+    for(ind=0; ind<nevent; ind++)
+        gtrMockVmeTrigger(pboard->intVec,-1);
+    return(0);
+}
+
+static void benchOne(benchBoard *pboard,const char *mode,int nevent,
+    int mask,int length,int ftvl)
+{
+    int nchannels = (*pboard->pgtrops->numberChannels)(pboard->pvt);
+    int elementSize = (ftvl==menuFtypeSHORT) ? 2 : 4;
+    int samplesPerElement = (ftvl==menuFtypeLONG) ? 2 : 1;
+    gtrchannel *pchannel;
+    gtrchannel **papchannel;
+    epicsTimeStamp start,now;
+    double seconds,samples,bytes;
+    long nreads = 0;
+    long ndata;
+    int nenabled = 0;
+    epicsInt32 rawLow,rawHigh;
+    double scale = 1.0;
+    int ind;
+
+    pchannel = calloc(nchannels,sizeof(gtrchannel));
+    papchannel = calloc(nchannels,sizeof(gtrchannel *));
+    if(!pchannel || !papchannel) {
+        printf("gtrBench: calloc failed\n");
+        exit(1);
+    }
+    (*pboard->pgtrops->getLimits)(pboard->pvt,&rawLow,&rawHigh);
+    if(rawHigh!=rawLow) scale = 1.0/(double)(rawHigh - rawLow);
+    for(ind=0; ind<nchannels; ind++) {
+        papchannel[ind] = &pchannel[ind];
+        pchannel[ind].ftvl = ftvl;
+        pchannel[ind].scale = scale;
+        pchannel[ind].offset = -(double)rawLow*scale;
+        if(!(mask&(1<<ind))) continue;
+        nenabled++;
+        pchannel[ind].len = length;
+        pchannel[ind].pdata = calloc(length,elementSize);
+        if(!pchannel[ind].pdata) {
+            printf("gtrBench: calloc failed\n");
+            exit(1);
+        }
+    }
+    epicsTimeGetCurrent(&start);
+    do {
+        if((*pboard->pgtrops->readMemory)(pboard->pvt,papchannel)
+            !=gtrStatusOK) {
+            printf("%-9s %-17s %6d %#6x %9d readMemory failed\n",
+                pboard->type,mode,nevent,mask,length);
+            goto done;
+        }
+        nreads++;
+        epicsTimeGetCurrent(&now);
+        seconds = epicsTimeDiffInSeconds(&now,&start);
+    } while(nreads<MINREADS || seconds<minSeconds);
+    ndata = 0;
+    for(ind=0; ind<nchannels; ind++) ndata += pchannel[ind].ndata;
+    samples = (double)ndata*samplesPerElement*nreads;
+    bytes = (double)ndata*elementSize*nreads;
+    if(samples<=0.0) {
+        printf("%-9s %-17s %6d %#6x %9d no data\n",
+            pboard->type,mode,nevent,mask,length);
+        goto done;
+    }
+    printf("%-9s %-17s %6d %#6x %9ld %10.3f %12.1f %10.1f\n",
+        pboard->type,mode,nevent,mask,
+        ndata*samplesPerElement/nenabled,
+        seconds*1e9/samples,samples/seconds/1e6,bytes/seconds/1e6);
+done:
+    for(ind=0; ind<nchannels; ind++) free(pchannel[ind].pdata);
+    free(papchannel);
+    free(pchannel);
+}
+
+static void benchBoardRun(benchBoard *pboard,int maxSamples)
+{
+    int nchannels = (*pboard->pgtrops->numberChannels)(pboard->pvt);
+    int masks[3];
+    int indLength,indEvent,indMask;
+
+    masks[0] = (1<<nchannels) - 1;
+    masks[1] = (1<<(nchannels/2)) - 1;
+    masks[2] = 1;
+    for(indLength=0; indLength<nlengths; indLength++) {
+        int length = lengths[indLength];
+
+        if(length>pboard->maxSamples || length>maxSamples) break;
+        for(indEvent=0; indEvent<nevents; indEvent++) {
+            int nevent = events[indEvent];
+
+            if(setup(pboard,armPostTrigger,nevent,length)==0) {
+                for(indMask=0; indMask<3; indMask++)
+                    benchOne(pboard,"postTrigger",nevent,masks[indMask],
+                        length,menuFtypeSHORT);
+                if(pboard->longMask)
+                    benchOne(pboard,"postTrigger/LONG",nevent,pboard->longMask,
+                        length,menuFtypeLONG);
+                if((*pboard->pgtrops->readsFloat)(pboard->pvt))
+                    benchOne(pboard,"postTrigger/FLOAT",nevent,masks[0],
+                        length,menuFtypeFLOAT);
+            }
+            if(setup(pboard,armPrePostTrigger,nevent,length)==0) {
+                for(indMask=0; indMask<3; indMask++)
+                    benchOne(pboard,"prePostTrigger",nevent,masks[indMask],
+                        length,menuFtypeSHORT);
+            }
+        }
+    }
+    (*pboard->pgtrops->arm)(pboard->pvt,0);
+}
+
+/* Words so each kernel runs its vector loops and its tail */
+static int verifyLengths[] = {255,256,257,1023,4097};
+#define nverifyLengths (sizeof(verifyLengths)/sizeof(verifyLengths[0]))
+#define VERIFYSHORT 70
+#define VERIFYGUARD 16
+#define VERIFYFILL  0x5a5a
+
+static epicsUInt32 verifyRandom(unsigned int *pseed)
+{
+    epicsUInt32 high,low;
+
+    *pseed = *pseed*1103515245u + 12345u;
+    high = (*pseed>>8)&0xffff;
+    *pseed = *pseed*1103515245u + 12345u;
+    low = (*pseed>>8)&0xffff;
+    return((high<<16)|low);
+}
+
+/* Room for doff+nwords values plus a guard at each end */
+static epicsInt16 *verifyShorts(int nwords,int doff)
+{
+    int size = doff + nwords + 2*VERIFYGUARD;
+    epicsInt16 *pbuf = malloc(size*sizeof(epicsInt16));
+    int ind;
+
+    for(ind=0; ind<size; ind++) pbuf[ind] = VERIFYFILL;
+    return(pbuf);
+}
+
+static int verifyGuards(const char *name,const epicsInt16 *pbuf,
+    int nwords,int doff)
+{
+    int size = doff + nwords + 2*VERIFYGUARD;
+    int ind;
+
+    for(ind=0; ind<size; ind++) {
+        if(ind>=VERIFYGUARD + doff && ind<VERIFYGUARD + doff + nwords)
+            continue;
+        if(pbuf[ind]!=VERIFYFILL) {
+            printf("%s nwords %d doff %d wrote outside at %d\n",
+                name,nwords,doff,ind - VERIFYGUARD - doff);
+            return(1);
+        }
+    }
+    return(0);
+}
+
+static int verifyValues(const char *name,const epicsInt16 *pdest,
+    const epicsInt16 *pexpect,int nwords,int soff,int doff)
+{
+    int ind;
+
+    for(ind=0; ind<nwords; ind++) {
+        if(pdest[ind]!=pexpect[ind]) {
+            printf("%s nwords %d soff %d doff %d word %d got %d expected %d\n",
+                name,nwords,soff,doff,ind,pdest[ind],pexpect[ind]);
+            return(1);
+        }
+    }
+    return(0);
+}
+
+static int verifyScale(const epicsInt16 *pvalue,int nwords,int doff)
+{
+    float *pfloat = malloc((doff + nwords + 1)*sizeof(float));
+    double *pdouble = malloc((doff + nwords + 1)*sizeof(double));
+    float fscale = 0.0123f, foffset = -1.5f;
+    double dscale = 0.0123, doffset = -1.5;
+    int errors = 0;
+    int ind;
+
+    gtrUnpackScaleFloat(pvalue,nwords,pfloat + doff,fscale,foffset);
+    gtrUnpackScaleDouble(pvalue,nwords,pdouble + doff,dscale,doffset);
+    for(ind=0; ind<nwords; ind++) {
+        float fexpect = (float)pvalue[ind]*fscale + foffset;
+        double dexpect = (double)pvalue[ind]*dscale + doffset;
+
+        /* A fused multiply add may round differently */
+        if(fabs(pfloat[doff + ind] - fexpect)>1e-5*(fabs(fexpect) + 1.0)
+        || fabs(pdouble[doff + ind] - dexpect)>1e-12*(fabs(dexpect) + 1.0)) {
+            printf("scale nwords %d doff %d word %d got %g %g expected %g %g\n",
+                nwords,doff,ind,pfloat[doff + ind],pdouble[doff + ind],
+                fexpect,dexpect);
+            errors = 1;
+            break;
+        }
+    }
+    free(pfloat);
+    free(pdouble);
+    return(errors);
+}
+
+/* One length with the source soff words and the destinations doff
+ * values past an aligned address. The source is allocated exactly,
+ * so a memory checker sees any read outside it. */
+static int verifyOne(int nwords,int soff,int doff,
+    epicsUInt16 highMask,epicsUInt16 lowMask,unsigned int *pseed)
+{
+    epicsUInt32 *pbuffer = malloc((soff + nwords + 1)*sizeof(epicsUInt32));
+    epicsUInt32 *psource = pbuffer + soff;
+    epicsInt16 *pexpectHigh = malloc((nwords + 1)*sizeof(epicsInt16));
+    epicsInt16 *pexpectLow = malloc((nwords + 1)*sizeof(epicsInt16));
+    epicsInt16 *phigh = verifyShorts(nwords,doff);
+    epicsInt16 *plow = verifyShorts(nwords,doff);
+    epicsInt16 *pone = verifyShorts(nwords,doff);
+    int start = VERIFYGUARD + doff;
+    int errors = 0;
+    int ind;
+
+    for(ind=0; ind<nwords; ind++) {
+        epicsUInt32 word = verifyRandom(pseed);
+
+        psource[ind] = word;
+        pexpectHigh[ind] = (epicsInt16)((word>>16)&highMask);
+        pexpectLow[ind] = (epicsInt16)(word&lowMask);
+    }
+    gtrUnpackPair(psource,nwords,phigh + start,highMask,plow + start,lowMask);
+    errors += verifyValues("pair high",phigh + start,pexpectHigh,
+        nwords,soff,doff);
+    errors += verifyValues("pair low",plow + start,pexpectLow,
+        nwords,soff,doff);
+    errors += verifyGuards("pair high",phigh,nwords,doff);
+    errors += verifyGuards("pair low",plow,nwords,doff);
+    gtrUnpackHigh(psource,nwords,pone + start,highMask);
+    errors += verifyValues("high",pone + start,pexpectHigh,nwords,soff,doff);
+    errors += verifyGuards("high",pone,nwords,doff);
+    gtrUnpackLow(psource,nwords,pone + start,lowMask);
+    errors += verifyValues("low",pone + start,pexpectLow,nwords,soff,doff);
+    errors += verifyGuards("low",pone,nwords,doff);
+    errors += verifyScale(pexpectHigh,nwords,doff);
+    free(pbuffer);
+    free(pexpectHigh);
+    free(pexpectLow);
+    free(phigh);
+    free(plow);
+    free(pone);
+    return(errors);
+}
+
+static int verifyKernels(void)
+{
+    /* All bits and the masks of the drivers. The random words also
+     * set bit 15, the sis3301 G bit, so sign extension is exercised */
+    static const epicsUInt16 masks[][2] = {
+        {0xffff,0xffff},{0x3fff,0x3fff},{0x0fff,0xffff}};
+    unsigned int seed = 1;
+    int ncases = 0, errors = 0;
+    int nwords,soff,doff;
+    unsigned int indMask,indLength;
+
+    for(indMask=0; indMask<sizeof(masks)/sizeof(masks[0]); indMask++) {
+        for(indLength=0; indLength<VERIFYSHORT + 1 + nverifyLengths;
+        indLength++) {
+            nwords = (indLength<=VERIFYSHORT) ? (int)indLength
+                : verifyLengths[indLength - VERIFYSHORT - 1];
+            for(soff=0; soff<4; soff++) for(doff=0; doff<8; doff++) {
+                errors += verifyOne(nwords,soff,doff,
+                    masks[indMask][0],masks[indMask][1],&seed);
+                ncases++;
+            }
+        }
+    }
+    printf("gtrUnpack %s kernels: %d cases %d errors\n",
+        gtrUnpackKernel(),ncases,errors);
+    return(errors ? 1 : 0);
+}
+
+/* Plans are checked for PLANEVENTS events of a buffer PLANSIZE words */
+#define PLANCASES  4000
+#define PLANEVENTS 4
+#define PLANSIZE   300
+
+/* A block of readout words of one event */
+typedef struct planBlock {
+    gtrUnpackPlan  *pplan;
+    int            index;
+    const epicsUInt32 *psource;
+    int            nwords;
+} planBlock;
+
+static int planRandom(unsigned int *pseed,int n)
+{
+    return((n>0) ? (int)(verifyRandom(pseed)%(epicsUInt32)n) : 0);
+}
+
+/* The per word loop that plans replaced. nskip may be negative */
+static void planReference(const epicsUInt32 *pbuffer,int size,int start,
+    int nwords,gtrchannel *phigh,epicsUInt16 highMask,int nskipHigh,
+    gtrchannel *plow,epicsUInt16 lowMask,int nskipLow)
+{
+    int ind;
+
+    if(nwords>size) nwords = size;
+    for(ind=0; ind<nwords; ind++) {
+        epicsUInt32 word = pbuffer[(start + ind)%size];
+
+        if(nskipHigh>0) {
+            nskipHigh--;
+        } else if(phigh->ndata<phigh->len) {
+            ((epicsInt16 *)phigh->pdata)[phigh->ndata++] =
+                (epicsInt16)((word>>16)&highMask);
+        }
+        if(nskipLow>0) {
+            nskipLow--;
+        } else if(plow->ndata<plow->len) {
+            ((epicsInt16 *)plow->pdata)[plow->ndata++] =
+                (epicsInt16)(word&lowMask);
+        }
+    }
+}
+
+/* A channel of len values whose first ndata are already filled */
+static void planChannel(gtrchannel *pchannel,epicsInt16 *pbuf,
+    int len,int ndata)
+{
+    memset(pchannel,0,sizeof(*pchannel));
+    pchannel->ftvl = menuFtypeSHORT;
+    pchannel->len = len;
+    pchannel->ndata = ndata;
+    pchannel->pdata = pbuf + VERIFYGUARD;
+}
+
+static int planCompare(const char *name,int ncase,
+    gtrchannel *pgot,const epicsInt16 *pgotBuf,
+    gtrchannel *pexpect,const epicsInt16 *pexpectBuf)
+{
+    int ind;
+
+    if(pgot->ndata!=pexpect->ndata) {
+        printf("plan case %d %s ndata %d expected %d\n",
+            ncase,name,pgot->ndata,pexpect->ndata);
+        return(1);
+    }
+    for(ind=0; ind<pgot->len + 2*VERIFYGUARD; ind++) {
+        if(pgotBuf[ind]!=pexpectBuf[ind]) {
+            printf("plan case %d %s value %d got %d expected %d\n",
+                ncase,name,ind - VERIFYGUARD,pgotBuf[ind],pexpectBuf[ind]);
+            return(1);
+        }
+    }
+    return(0);
+}
+
+/* Makes the plans for all events first, as the drivers do, and runs them
+ * with gtrUnpackPlanRun, or as blocks of random size in random order */
+static int verifyPlanOne(int ncase,int byBlock,unsigned int *pseed)
+{
+    epicsUInt32 buffer[PLANEVENTS][PLANSIZE];
+    gtrUnpackPlan plan[PLANEVENTS];
+    planBlock block[PLANEVENTS*PLANSIZE];
+    epicsInt16 bufHigh[PLANSIZE*PLANEVENTS + 2*VERIFYGUARD];
+    epicsInt16 bufLow[PLANSIZE*PLANEVENTS + 2*VERIFYGUARD];
+    epicsInt16 refHigh[PLANSIZE*PLANEVENTS + 2*VERIFYGUARD];
+    epicsInt16 refLow[PLANSIZE*PLANEVENTS + 2*VERIFYGUARD];
+    gtrchannel high,low,expectHigh,expectLow;
+    epicsUInt16 highMask = (ncase&1) ? 0x3fff : 0xffff;
+    epicsUInt16 lowMask = (ncase&2) ? 0x8fff : 0xffff;
+    int size = 1 + planRandom(pseed,PLANSIZE);
+    int nevent = 1 + planRandom(pseed,PLANEVENTS);
+    int lenHigh = planRandom(pseed,size*nevent + 2);
+    int lenLow = planRandom(pseed,size*nevent + 2);
+    int ndataHigh = planRandom(pseed,lenHigh + 1);
+    int ndataLow = planRandom(pseed,lenLow + 1);
+    int nblock = 0;
+    int event,ind;
+
+    for(ind=0; ind<PLANSIZE*PLANEVENTS + 2*VERIFYGUARD; ind++)
+        bufHigh[ind] = bufLow[ind] = refHigh[ind] = refLow[ind] = VERIFYFILL;
+    planChannel(&high,bufHigh,lenHigh,ndataHigh);
+    planChannel(&low,bufLow,lenLow,ndataLow);
+    planChannel(&expectHigh,refHigh,lenHigh,ndataHigh);
+    planChannel(&expectLow,refLow,lenLow,ndataLow);
+    for(event=0; event<nevent; event++) {
+        int start = planRandom(pseed,size);
+        int nwords = planRandom(pseed,size + 3);
+        int nskipHigh = planRandom(pseed,nwords + 3) - 1;
+        int nskipLow = planRandom(pseed,nwords + 3) - 1;
+
+        for(ind=0; ind<size; ind++) buffer[event][ind] = verifyRandom(pseed);
+        planReference(buffer[event],size,start,nwords,
+            &expectHigh,highMask,nskipHigh,&expectLow,lowMask,nskipLow);
+        gtrUnpackPlanMake(&plan[event],size,start,nwords,
+            &high,highMask,nskipHigh,&low,lowMask,nskipLow);
+    }
+    if(high.ndata!=expectHigh.ndata || low.ndata!=expectLow.ndata) {
+        printf("plan case %d gtrUnpackPlanMake ndata %d %d expected %d %d\n",
+            ncase,high.ndata,low.ndata,expectHigh.ndata,expectLow.ndata);
+        return(1);
+    }
+    if(!byBlock) {
+        for(event=nevent - 1; event>=0; event--)
+            gtrUnpackPlanRun(&plan[event],buffer[event]);
+    } else {
+        for(event=0; event<nevent; event++) {
+            gtrUnpackPlan *pplan = &plan[event];
+
+            for(ind=0; ind<pplan->nspan; ind++) {
+                gtrUnpackSpan *pspan = &pplan->span[ind];
+                int done = 0;
+
+                while(done<pspan->count) {
+                    planBlock *pblock = &block[nblock++];
+                    int n = 1 + planRandom(pseed,pspan->count/4 + 8);
+
+                    if(n>pspan->count - done) n = pspan->count - done;
+                    pblock->pplan = pplan;
+                    pblock->index = pspan->index + done;
+                    pblock->psource = buffer[event] + pspan->offset + done;
+                    pblock->nwords = n;
+                    done += n;
+                }
+            }
+        }
+        for(ind=nblock - 1; ind>0; ind--) {
+            int other = planRandom(pseed,ind + 1);
+            planBlock swap = block[ind];
+
+            block[ind] = block[other];
+            block[other] = swap;
+        }
+        for(ind=0; ind<nblock; ind++) {
+            gtrUnpackPlanBlock(block[ind].pplan,block[ind].index,
+                block[ind].psource,block[ind].nwords);
+        }
+    }
+    return(planCompare("high",ncase,&high,bufHigh,&expectHigh,refHigh)
+        + planCompare("low",ncase,&low,bufLow,&expectLow,refLow));
+}
+
+static int verifyPlans(void)
+{
+    unsigned int seed = 7;
+    int errors = 0;
+    int ncase;
+
+    for(ncase=0; ncase<PLANCASES; ncase++)
+        errors += verifyPlanOne(ncase,ncase%3!=0,&seed);
+    printf("gtrUnpackPlan: %d cases %d errors\n",PLANCASES,errors);
+    return(errors ? 1 : 0);
+}
+
+static void usage(void)
+{
+    unsigned int ind;
+
+    printf("usage: gtrBench [-s seconds] [-n maxSamples] [-d useDma]"
+        " [-b MB/s] [-a] [-w workers] [board ...]\n");
+    printf("       gtrBench -v\n");
+    printf("board is one of");
+    for(ind=0; ind<nboards; ind++) printf(" %s",boards[ind].type);
+    printf("\n");
+}
+
+int main(int argc,char *argv[])
+{
+    int maxSamples = lengths[nlengths - 1];
+    double mbps = 0.0;
+    int autoDma = 0;
+    int selected[nboards];
+    int nselected = 0;
+    unsigned int ind;
+    int arg;
+
+    memset(selected,0,sizeof(selected));
+    for(arg=1; arg<argc; arg++) {
+        if(strcmp(argv[arg],"-s")==0 && arg+1<argc) {
+            minSeconds = atof(argv[++arg]);
+        } else if(strcmp(argv[arg],"-n")==0 && arg+1<argc) {
+            maxSamples = atoi(argv[++arg]);
+        } else if(strcmp(argv[arg],"-d")==0 && arg+1<argc) {
+            useDma = atoi(argv[++arg]);
+        } else if(strcmp(argv[arg],"-b")==0 && arg+1<argc) {
+            mbps = atof(argv[++arg]);
+        } else if(strcmp(argv[arg],"-a")==0) {
+            autoDma = 1;
+        } else if(strcmp(argv[arg],"-v")==0) {
+            return(verifyKernels() | verifyPlans());
+        } else if(strcmp(argv[arg],"-w")==0 && arg+1<argc) {
+            gtrBtrWorkers = atoi(argv[++arg]);
+        } else {
+            for(ind=0; ind<nboards; ind++) {
+                if(strcmp(argv[arg],boards[ind].type)==0) break;
+            }
+            if(ind>=nboards) {
+                usage();
+                return(1);
+            }
+            selected[ind] = 1;
+            nselected++;
+        }
+    }
+    gtrMockVmeInstall();
+    gtrBtrAutoDma = autoDma;
+    if(useDma) {
+        if(gtrMockDmaConfig(mbps,2.0*mbps,4.0*mbps,0.0)) return(1);
+        vtr812UseDma = 1;
+    }
+    printf("%-9s %-17s %6s %6s %9s %10s %12s %10s\n",
+        "board","mode","events","mask","samp/chan",
+        "ns/sample","Msamples/s","MB/s");
+    for(ind=0; ind<nboards; ind++) {
+        benchBoard *pboard = &boards[ind];
+
+        if(nselected && !selected[ind]) continue;
+        if(gtrMockVmeConfig(pboard->type,pboard->a16offset,
+            pboard->a32offset,pboard->intVec,pboard->maxSamples)) continue;
+        (*pboard->config)(pboard);
+        pboard->pvt = gtrFind(pboard->card,&pboard->pgtrops);
+        if(!pboard->pvt) {
+            printf("gtrBench: %s was not configured\n",pboard->type);
+            continue;
+        }
+        (*pboard->pgtrops->init)(pboard->pvt);
+        benchBoardRun(pboard,maxSamples);
+    }
+    return(0);
+}